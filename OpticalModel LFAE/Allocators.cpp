@@ -0,0 +1,101 @@
+#include "stdafx.h"
+
+#include "Allocators.h"
+
+#ifdef _WIN32
+
+#define NOMINMAX
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#include <malloc.h>
+
+void* AllocateAligned(size_t bytes, size_t alignment)
+{
+    auto block = _aligned_malloc(bytes ? bytes : 1, alignment);
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+
+    return block;
+}
+
+void FreeAligned(void* block)
+{
+    _aligned_free(block);
+}
+
+// Large pages need the lock pages in memory privilege; without it the
+// request fails and ordinary pages are used
+void* AllocatePages(size_t bytes)
+{
+    auto largePage = GetLargePageMinimum();
+    if (largePage && bytes >= largePage && bytes % largePage == 0)
+    {
+        auto block = VirtualAlloc(nullptr, bytes, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+        if (block)
+        {
+            return block;
+        }
+    }
+
+    auto block = VirtualAlloc(nullptr, bytes ? bytes : 1, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+    if (!block)
+    {
+        throw std::bad_alloc();
+    }
+
+    return block;
+}
+
+void FreePages(void* block, size_t)
+{
+    VirtualFree(block, 0, MEM_RELEASE);
+}
+
+#else
+
+#include <stdlib.h>
+#include <sys/mman.h>
+
+void* AllocateAligned(size_t bytes, size_t alignment)
+{
+    void* block = nullptr;
+    if (posix_memalign(&block, alignment, bytes ? bytes : 1) != 0)
+    {
+        throw std::bad_alloc();
+    }
+
+    return block;
+}
+
+void FreeAligned(void* block)
+{
+    free(block);
+}
+
+void* AllocatePages(size_t bytes)
+{
+    auto block = mmap(nullptr, bytes ? bytes : 1, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (block == MAP_FAILED)
+    {
+        throw std::bad_alloc();
+    }
+
+#ifdef MADV_HUGEPAGE
+    static const size_t HugePage = 2 << 20;
+    if (bytes >= HugePage)
+    {
+        madvise(block, bytes, MADV_HUGEPAGE);
+    }
+#endif
+
+    return block;
+}
+
+void FreePages(void* block, size_t bytes)
+{
+    munmap(block, bytes ? bytes : 1);
+}
+
+#endif
@@ -0,0 +1,82 @@
+#pragma once
+
+#include <new>
+#include <stddef.h>
+
+// Storage for the large arrays (Array2D and friends)
+//
+// AlignedAllocator  - heap blocks aligned to Alignment bytes (a cache line
+//                     by default), so rows can start on a SIMD boundary
+// PageAllocator     - whole pages straight from the system, with huge pages
+//                     asked for on large blocks, for arrays of hundreds of
+//                     MB that are streamed end to end
+
+void* AllocateAligned(size_t bytes, size_t alignment);
+void FreeAligned(void* block);
+
+void* AllocatePages(size_t bytes);
+void FreePages(void* block, size_t bytes);
+
+template<typename T, size_t Alignment = 64>
+class AlignedAllocator
+{
+public:
+    typedef T value_type;
+    static const size_t alignment = Alignment;
+
+    template<typename U>
+    struct rebind
+    {
+        typedef AlignedAllocator<U, Alignment> other;
+    };
+
+    AlignedAllocator() {}
+
+    template<typename U>
+    AlignedAllocator(AlignedAllocator<U, Alignment> const&) {}
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(AllocateAligned(count * sizeof(T), Alignment < alignof(T) ? alignof(T) : Alignment));
+    }
+
+    void deallocate(T* block, size_t)
+    {
+        FreeAligned(block);
+    }
+
+    template<typename U>
+    bool operator ==(AlignedAllocator<U, Alignment> const&) const { return true; }
+
+    template<typename U>
+    bool operator !=(AlignedAllocator<U, Alignment> const&) const { return false; }
+};
+
+template<typename T>
+class PageAllocator
+{
+public:
+    typedef T value_type;
+    static const size_t alignment = 4096;
+
+    PageAllocator() {}
+
+    template<typename U>
+    PageAllocator(PageAllocator<U> const&) {}
+
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(AllocatePages(count * sizeof(T)));
+    }
+
+    void deallocate(T* block, size_t count)
+    {
+        FreePages(block, count * sizeof(T));
+    }
+
+    template<typename U>
+    bool operator ==(PageAllocator<U> const&) const { return true; }
+
+    template<typename U>
+    bool operator !=(PageAllocator<U> const&) const { return false; }
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+
+#include <assert.h>
+#include <math.h>
+
+// Gaussian illumination of a lens by its fiber tip.  The fiber mode has a
+// waist of Demitter / 2 at the tip, and the lens of radius Rlens sits at the
+// distance where it just fills the NAemitter cone, f = Rlens / tan(asin(NA)).
+// The 1/e^2 intensity radius of the beam at the lens is then
+//   w = w0 sqrt(1 + (f / zR)^2),  zR = pi w0^2 / lambda
+// With f far beyond zR this is a fixed fraction of Rlens, so lenses scaled
+// from the template share its apodization.
+template<typename T>
+T GaussianBeamRadius(T Demitter, T NAemitter, T lambda, T Rlens)
+{
+    assert(Demitter > 0);
+    assert(NAemitter > 0 && NAemitter < 1);
+    assert(lambda > 0);
+
+    auto w0 = Demitter / 2;
+    auto zR = M_PI * w0 * w0 / lambda;
+    auto f = Rlens / tan(asin(NAemitter));
+
+    return static_cast<T>(w0 * sqrt(1 + (f / zR) * (f / zR)));
+}
+
+// field amplitude at radius r in a beam of 1/e^2 intensity radius w,
+// relative to the center of the beam
+template<typename T>
+T GaussianAmplitude(T r, T w)
+{
+    return static_cast<T>(exp(-(r * r) / (w * w)));
+}
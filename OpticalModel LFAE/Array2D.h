@@ -6,86 +6,178 @@
 #include <complex>
 #include <math.h>
 #include <vector>
+#include "Allocators.h"
 
-// Incomplete class
-// Does not correctly deal with Array2D const&
+// One row of an Array2D - a pointer and a length.  T is const for a view
+// of a const array.  Indexing is pointer arithmetic; the bounds are only
+// checked by the debug asserts.
 template<typename T>
-class Array2D
+class Array2DRow
 {
 public:
     typedef T value_type;
-    typedef value_type& reference;
-    typedef value_type const& const_reference;
-    using vector = std::vector<value_type>;
-    using iterator = typename std::vector<value_type>::iterator;
-    using const_iterator = typename std::vector<value_type>::const_iterator;
+    typedef T* iterator;
 
+    Array2DRow(T* data, int cols) : m_data(data), m_cols(cols)
+    {
+    }
 
-    class Accessor
+    T& operator [](int column) const
     {
-    public:
-        Accessor(vector &data, int offset, int colSize) :
-            data(data), offset(offset), colSize(colSize)
-        {
-        }
+        assert(column >= 0 && column < m_cols);
+        return m_data[column];
+    }
 
-        reference operator [](int column)
-        {
-            assert(column >= 0 && column < colSize);
-            return data[offset + column];
-        }
+    T* begin() const { return m_data; }
+    T* end() const { return m_data + m_cols; }
+    T* data() const { return m_data; }
+    int size() const { return m_cols; }
 
-        iterator begin()
-        {
-            return data.begin() + offset;
-        }
+private:
+    T* m_data;
+    int m_cols;
+};
 
-        iterator end()
-        {
-            return data.begin() + offset + colSize;
-        }
+// A rows x cols window of an Array2D, row r starting stride elements after
+// row r - 1
+template<typename T>
+class Array2DTile
+{
+public:
+    typedef T value_type;
 
-        int size() const
-        {
-            return colSize;
-        }
+    Array2DTile(T* data, int rows, int cols, size_t stride) :
+        m_data(data), m_rows(rows), m_cols(cols), m_stride(stride)
+    {
+    }
 
-        const_reference operator [](int column) const
-        {
-            assert(column >= 0 && column < colSize);
-            return data[offset + column];
-        }
+    T& operator ()(int row, int column) const
+    {
+        assert(row >= 0 && row < m_rows);
+        assert(column >= 0 && column < m_cols);
+        return m_data[row * m_stride + column];
+    }
+
+    Array2DRow<T> operator [](int row) const
+    {
+        assert(row >= 0 && row < m_rows);
+        return Array2DRow<T>(m_data + row * m_stride, m_cols);
+    }
+
+    T* data() const { return m_data; }
+    int rows() const { return m_rows; }
+    int cols() const { return m_cols; }
+    size_t stride() const { return m_stride; }
+
+private:
+    T* m_data;
+    int m_rows;
+    int m_cols;
+    size_t m_stride;
+};
+
+// Row major rows x cols array in storage from Allocator (aligned to a cache
+// line by default).  With padRows each row is padded out to a whole number
+// of cache lines, so every row starts aligned; the padding is never part of
+// the array, and the flat begin() .. end() range is only available without
+// it.
+template<typename T, typename Allocator = AlignedAllocator<T>>
+class Array2D
+{
+public:
+    typedef T value_type;
+    typedef value_type& reference;
+    typedef value_type const& const_reference;
+    typedef T* iterator;
+    typedef T const* const_iterator;
+    typedef Array2DRow<T> Row;
+    typedef Array2DRow<T const> ConstRow;
+    typedef Array2DTile<T> Tile;
+    typedef Array2DTile<T const> ConstTile;
+
+    static const size_t RowAlignment = 64;
 
-    private:
-        vector &data;
-        int offset;
-        int colSize;
-    };
+    Array2D() : m_rows(0), m_cols(0), m_stride(0)
+    {
+    }
 
-    Array2D(int row, int col) : m_rows(row), m_cols(col), m_data(col * row)
+    Array2D(int row, int col, bool padRows = false) :
+        m_rows(row), m_cols(col), m_stride(PaddedStride(col, padRows)),
+        m_data(row * m_stride)
     {
         assert(col > 0);
         assert(row > 0);
     }
 
-    Accessor operator [](int row)
+    Row operator [](int row)
+    {
+        assert(row >= 0 && row < m_rows);
+        return Row(m_data.data() + row * m_stride, m_cols);
+    }
+
+    ConstRow operator [](int row) const
+    {
+        assert(row >= 0 && row < m_rows);
+        return ConstRow(m_data.data() + row * m_stride, m_cols);
+    }
+
+    reference operator ()(int row, int column)
     {
         assert(row >= 0 && row < m_rows);
-        return Accessor(m_data, row * m_cols, m_cols);
+        assert(column >= 0 && column < m_cols);
+        return m_data[row * m_stride + column];
     }
 
-    iterator begin() { return m_data.begin(); }
-    iterator end() { return m_data.end(); }
-    size_t size() const { return m_data.size(); }
+    const_reference operator ()(int row, int column) const
+    {
+        assert(row >= 0 && row < m_rows);
+        assert(column >= 0 && column < m_cols);
+        return m_data[row * m_stride + column];
+    }
+
+    Tile Window(int row, int column, int rows, int cols)
+    {
+        assert(row >= 0 && rows >= 0 && row + rows <= m_rows);
+        assert(column >= 0 && cols >= 0 && column + cols <= m_cols);
+        return Tile(m_data.data() + row * m_stride + column, rows, cols, m_stride);
+    }
+
+    ConstTile Window(int row, int column, int rows, int cols) const
+    {
+        assert(row >= 0 && rows >= 0 && row + rows <= m_rows);
+        assert(column >= 0 && cols >= 0 && column + cols <= m_cols);
+        return ConstTile(m_data.data() + row * m_stride + column, rows, cols, m_stride);
+    }
+
+    iterator begin() { assert(!padded()); return m_data.data(); }
+    iterator end() { assert(!padded()); return m_data.data() + m_data.size(); }
+    const_iterator begin() const { assert(!padded()); return m_data.data(); }
+    const_iterator end() const { assert(!padded()); return m_data.data() + m_data.size(); }
+
+    T* data() { return m_data.data(); }
+    T const* data() const { return m_data.data(); }
+
+    size_t size() const { return static_cast<size_t>(m_rows) * m_cols; }
     int cols() const { return m_cols; }
     int rows() const { return m_rows; }
-
-    const_iterator begin() const { return m_data.begin(); }
-    const_iterator end() const { return m_data.end(); }
+    size_t stride() const { return m_stride; }
+    bool padded() const { return m_stride != static_cast<size_t>(m_cols); }
 
 private:
+    static size_t PaddedStride(int col, bool padRows)
+    {
+        size_t stride = col;
+        if (padRows && sizeof(T) < RowAlignment && RowAlignment % sizeof(T) == 0)
+        {
+            auto perLine = RowAlignment / sizeof(T);
+            stride = (stride + perLine - 1) / perLine * perLine;
+        }
+
+        return stride;
+    }
+
     int m_rows;
     int m_cols;
-    vector m_data;
+    size_t m_stride;
+    std::vector<T, Allocator> m_data;
 };
-
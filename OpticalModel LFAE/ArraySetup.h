@@ -2,8 +2,10 @@
 
 #define _USE_MATH_DEFINES
 
+#include <assert.h>
 #include <math.h>
 #include <vector>
+#include "LazyRange.h"
 #include "Vector3.h"
 
 using std::vector;
@@ -13,58 +15,100 @@ using std::vector;
 //%   center, and then add successive shells around it
 //
 
+//% determine lens optical axis centers shell by shell
+//% within each shell, the optical axis centers fall on the edges and
+//% vertices of a hexagon
+//% leave the z - values at 0, since nominal positions are in the x - y plane
+//
+// ArrayLattice gives center i of that list directly from i, in the same
+// order ArraySetup has always used:
+//   0                     the center
+//   1 .. 6 n_shells       the 6 vertices of each shell, shell by shell
+//   then                  the k - 1 points on each of the 6 edges of shell
+//                         k = 2 .. n_shells, edge by edge
+// so any part of a large array can be produced without building the rest.
 template<typename T>
-vector<Point3<T>> ArraySetup(int n_shells, T pitch)
+class ArrayLattice
 {
-    //% determine lens optical axis centers shell by shell
-    //% within each shell, the optical axis centers fall on the edges and
-    //% vertices of a hexagon
-    //% leave the z - values at 0, since nominal positions are in the x - y plane
-    vector<Point3<T>> oa_ctr;
+public:
+    typedef Point3<T> value_type;
+    typedef IndexIterator<ArrayLattice> const_iterator;
 
-    // Create a center starting point
-    oa_ctr.push_back(Point3<T>());
+    ArrayLattice(int n_shells, T pitch) : n_shells(n_shells), pitch(pitch)
+    {
+        assert(n_shells >= 0);
+    }
 
-    //% first, populate the 6 vertices in every hexagonal shell
-    for (int i_shell = 1; i_shell <= n_shells; ++i_shell)
+    // 1 + 6 n + 3 n (n - 1)
+    size_t size() const
     {
-        for (int i_vertex = 0; i_vertex < 6; ++i_vertex)
-        {
-            oa_ctr.push_back(Point3<T>(
-                static_cast<T>(i_shell * pitch * cos(i_vertex * M_PI / 3)),
-                static_cast<T>(i_shell * pitch * sin(i_vertex * M_PI / 3)),
-                static_cast<T>(0)));
-        }
+        return 1 + 3 * static_cast<size_t>(n_shells) * (n_shells + 1);
     }
 
-    //% second, populate the edges in the hexagonal shell, based on the
-    //% location of the 6 vertices in the shell
-    for (int i_shell = 2; i_shell <= n_shells; ++i_shell)
+    Point3<T> operator [](size_t i) const
     {
-        //for i_edge = 1 : 6
-        for (int i_edge = 1; i_edge <= 6; ++i_edge)
+        assert(i < size());
+
+        if (i == 0)
+        {
+            return Point3<T>();
+        }
+
+        auto n_vertices = 6 * static_cast<size_t>(n_shells);
+        if (i <= n_vertices)
+        {
+            return Vertex(static_cast<int>((i - 1) / 6) + 1, static_cast<int>((i - 1) % 6));
+        }
+
+        // shells 2 .. k - 1 have 3 (k - 1) (k - 2) edge points between them;
+        // find s = k - 1 with 3 s (s - 1) <= j < 3 (s + 1) s
+        auto j = i - 1 - n_vertices;
+        auto s = static_cast<size_t>((1 + sqrt(1 + 4 * static_cast<double>(j) / 3)) / 2);
+        while (3 * s * (s - 1) > j)
         {
-            //% find the indices of the six vertices in the shell
-            //% the first lens occupies index i = 1
-            //% shell 1 : i = { 2, 3, 4, 5, 6, 7 }
-            //% shell 2 : i = { 8, 9, 10, 11, 12, 13 }
-            //% shell k : i = 6 * (k - 1) + {2, 3, 4, 5, 6, 7}
-            int i_p1 = 6 * (i_shell - 1) + i_edge;
-            auto p1 = oa_ctr[i_p1];
-            auto i_p2 = (i_p1 + 1) % 6;
-            auto p2 = oa_ctr[i_p2];
-            auto v = (p2 - p1).Normalize();
-            //% there are k edge points in the kth shell
-            for (int i_edge_lens = 1; i_edge_lens < i_shell; ++i_edge_lens)
-            {
-                oa_ctr.push_back(Point3<T>(
-                    static_cast<T>(p1.X() + i_edge_lens * pitch * v.X()),
-                    static_cast<T>(p1.Y() + i_edge_lens * pitch * v.Y()),
-                    static_cast<T>(0)));
-
-            }
+            --s;
         }
+        while (3 * (s + 1) * s <= j)
+        {
+            ++s;
+        }
+
+        auto i_shell = static_cast<int>(s + 1);
+        auto r = j - 3 * s * (s - 1);
+        auto i_edge = static_cast<int>(r / s);
+        auto i_edge_lens = static_cast<int>(r % s) + 1;
+
+        //% there are k edge points in the kth shell, stepping from one
+        //% vertex toward the next
+        auto p1 = Vertex(i_shell, i_edge);
+        auto p2 = Vertex(i_shell, (i_edge + 1) % 6);
+        auto v = (p2 - p1).Normalize();
+
+        return Point3<T>(
+            static_cast<T>(p1.X() + i_edge_lens * pitch * v.X()),
+            static_cast<T>(p1.Y() + i_edge_lens * pitch * v.Y()),
+            static_cast<T>(0));
     }
 
-    return oa_ctr;
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+private:
+    Point3<T> Vertex(int i_shell, int i_vertex) const
+    {
+        return Point3<T>(
+            static_cast<T>(i_shell * pitch * cos(i_vertex * M_PI / 3)),
+            static_cast<T>(i_shell * pitch * sin(i_vertex * M_PI / 3)),
+            static_cast<T>(0));
+    }
+
+    int n_shells;
+    T pitch;
+};
+
+template<typename T>
+vector<Point3<T>> ArraySetup(int n_shells, T pitch)
+{
+    ArrayLattice<T> lattice(n_shells, pitch);
+    return vector<Point3<T>>(lattice.begin(), lattice.end());
 }
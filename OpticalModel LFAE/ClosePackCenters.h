@@ -1,6 +1,10 @@
 #pragma once
 
+#include <algorithm>
+#include <assert.h>
+#include <math.h>
 #include <vector>
+#include "LazyRange.h"
 #include "Vector3.h"
 
 // Remove once we have established that we have the right algorithm
@@ -15,58 +19,152 @@ std::vector<FloatPoint> ClosePackCentersFloat(int nshells, double outer_rad);
 //
 //% build discretization centers by rows in the circular aperture
 //% leave the z - values at 0, since nominal positions are in the x - y plane
+//
+// ClosePackLattice gives center i of that list directly from i, in the same
+// order ClosePackCenters has always used:
+//   0                     the center
+//   1 .. 2 nshells        the circles on the x-axis, +x then -x
+//   then                  row by row, the y-axis pair on even rows followed
+//                         by the (+-x, +-y) quadruples outward along the row
+// Only the number of circles in each row is kept (one entry per row, found
+// from the row's chord without walking it), so a point costs a binary search
+// over the rows and any part of a large template can be produced on its own.
 template<typename T>
-std::vector<Point3<T>> ClosePackCenters(int nshells, T outer_rad, T& discr_rad)
+class ClosePackLattice
 {
-    discr_rad = outer_rad / (2 * nshells + 1);
-    int nrow = static_cast<int>(round(outer_rad / discr_rad + 1));
-    std::vector<Point3<T>> discr_ctr;
+public:
+    typedef Point3<T> value_type;
+    typedef IndexIterator<ClosePackLattice> const_iterator;
+
+    ClosePackLattice(int nshells, T outer_rad) :
+        nshells(nshells), outer_rad(outer_rad),
+        discr_rad(outer_rad / (2 * nshells + 1)),
+        sqrt3(sqrt(3)),
+        radiusLimit(0.999*discr_rad)
+    {
+        assert(nshells >= 0);
+
+        auto rowlimit = static_cast<int>(floor(2 * nshells / sqrt(3)));
 
-    // the center is at the origin
-    discr_ctr.push_back(Point3<T>());
+        // rowStart[irow] is the index of the first center of row irow, and
+        // rowStart[rowlimit + 1] is the size of the lattice
+        rowStart.resize(rowlimit + 2);
+        rowStart[1] = 1 + 2 * static_cast<size_t>(nshells);
+        for (int irow = 1; irow <= rowlimit; ++irow)
+        {
+            rowStart[irow + 1] = rowStart[irow] + RowSize(irow);
+        }
+    }
 
-    // Create the circles that lie on the x-axis
-    for (int icol = 1; icol <= nshells; ++icol)
+    T DiscrRad() const
     {
-        auto xcenter = static_cast<T>(2 * icol * discr_rad);
-        discr_ctr.push_back(Point3<T>(xcenter, 0, 0));
-        discr_ctr.push_back(Point3<T>(-xcenter, 0, 0));
+        return discr_rad;
     }
 
-    auto rowlimit = static_cast<int>(floor(2 * nshells / sqrt(3)));
-    auto sqrt3 = sqrt(3);
-    auto radiusLimit = 0.999*discr_rad;
+    size_t size() const
+    {
+        return rowStart.back();
+    }
 
-    for (int irow = 1; irow <= rowlimit; ++irow)
+    Point3<T> operator [](size_t i) const
     {
-        // Even numbered rows have a center along the y-axis
-        if ((irow & 1) == 0)
+        assert(i < size());
+
+        // the center is at the origin
+        if (i == 0)
         {
-            auto ycenter = static_cast<T> (irow*discr_rad*sqrt(3));
+            return Point3<T>();
+        }
 
-            discr_ctr.push_back(Point3<T>(0, ycenter, 0));
-            discr_ctr.push_back(Point3<T>(0, -ycenter, 0));
+        // the circles that lie on the x-axis
+        if (i < rowStart[1])
+        {
+            auto icol = static_cast<int>((i - 1) / 2) + 1;
+            auto xcenter = static_cast<T>(2 * icol * discr_rad);
+            return Point3<T>(((i - 1) & 1) ? -xcenter : xcenter, 0, 0);
         }
 
-        auto yctr = static_cast<T>(irow * discr_rad * sqrt3);
+        auto irow = static_cast<int>(std::upper_bound(rowStart.begin() + 1, rowStart.end(), i) - rowStart.begin()) - 1;
+        auto offset = i - rowStart[irow];
+        auto yctr = RowY(irow);
 
-        for (int icol = 1; icol <= nshells; ++icol)
+        // Even numbered rows have a center along the y-axis
+        if ((irow & 1) == 0)
         {
-            auto xctr = static_cast<T>((2 * icol - (irow & 1)) * discr_rad);
-
-            auto radius = sqrt(xctr * xctr + yctr * yctr);
-            if (radius > outer_rad - radiusLimit)
+            if (offset < 2)
             {
-                // Once we are outside the limit, stop looking and go to the next row
-                break;
+                return Point3<T>(0, offset ? -yctr : yctr, 0);
             }
 
-            discr_ctr.push_back(Point3<T>(xctr, yctr, 0));
-            discr_ctr.push_back(Point3<T>(-xctr, yctr, 0));
-            discr_ctr.push_back(Point3<T>(xctr, -yctr, 0));
-            discr_ctr.push_back(Point3<T>(-xctr, -yctr, 0));
+            offset -= 2;
         }
+
+        auto icol = static_cast<int>(offset / 4) + 1;
+        auto xctr = RowX(irow, icol);
+        auto quadrant = offset % 4;
+
+        return Point3<T>((quadrant & 1) ? -xctr : xctr, (quadrant & 2) ? -yctr : yctr, 0);
     }
 
-    return discr_ctr;
-}
\ No newline at end of file
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+private:
+    T RowY(int irow) const
+    {
+        return static_cast<T>(irow * discr_rad * sqrt3);
+    }
+
+    T RowX(int irow, int icol) const
+    {
+        return static_cast<T>((2 * icol - (irow & 1)) * discr_rad);
+    }
+
+    bool Inside(int irow, int icol) const
+    {
+        auto xctr = RowX(irow, icol);
+        auto yctr = RowY(irow);
+
+        auto radius = sqrt(xctr * xctr + yctr * yctr);
+        return !(radius > outer_rad - radiusLimit);
+    }
+
+    // Circles in row irow.  The radius grows along the row, so the row ends
+    // at the first column outside the limit; the chord gives that column up
+    // to rounding, and the exact test settles the last one or two.
+    size_t RowSize(int irow) const
+    {
+        auto limit = outer_rad - radiusLimit;
+        auto y = static_cast<double>(RowY(irow));
+        auto chord = (limit > y) ? sqrt(limit * limit - y * y) : 0.0;
+
+        auto ncols = static_cast<int>(floor((chord / discr_rad + (irow & 1)) / 2));
+        ncols = std::max(0, std::min(nshells, ncols));
+        while (ncols > 0 && !Inside(irow, ncols))
+        {
+            --ncols;
+        }
+        while (ncols < nshells && Inside(irow, ncols + 1))
+        {
+            ++ncols;
+        }
+
+        return 4 * static_cast<size_t>(ncols) + (((irow & 1) == 0) ? 2 : 0);
+    }
+
+    int nshells;
+    T outer_rad;
+    T discr_rad;
+    double sqrt3;
+    double radiusLimit;
+    std::vector<size_t> rowStart;
+};
+
+template<typename T>
+std::vector<Point3<T>> ClosePackCenters(int nshells, T outer_rad, T& discr_rad)
+{
+    ClosePackLattice<T> lattice(nshells, outer_rad);
+    discr_rad = lattice.DiscrRad();
+
+    return std::vector<Point3<T>>(lattice.begin(), lattice.end());
+}
@@ -0,0 +1,96 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+
+#include <math.h>
+#include <stdint.h>
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel random
+// numbers: as easy as 1, 2, 3").  Each output block is a pure function of the
+// key and the counter, so a stream keyed by (seed, stream, substream) gives
+// the same numbers whichever thread draws it and in whatever order.
+//
+// The key is the seed; counter words 2 and 3 are the stream and substream
+// (e.g. trial and lens), and words 0 and 1 count the blocks drawn.
+class Philox4x32
+{
+public:
+    Philox4x32(uint64_t seed, uint32_t stream = 0, uint32_t substream = 0) :
+        m_block(0), m_used(4)
+    {
+        m_key[0] = static_cast<uint32_t>(seed);
+        m_key[1] = static_cast<uint32_t>(seed >> 32);
+        m_stream[0] = stream;
+        m_stream[1] = substream;
+    }
+
+    // One block of the raw generator
+    static void Block(uint32_t const counter[4], uint32_t const key[2], uint32_t out[4])
+    {
+        uint32_t c[4] = { counter[0], counter[1], counter[2], counter[3] };
+        uint32_t k[2] = { key[0], key[1] };
+
+        for (int round = 0; round < 10; ++round)
+        {
+            uint64_t p0 = static_cast<uint64_t>(0xD2511F53) * c[0];
+            uint64_t p1 = static_cast<uint64_t>(0xCD9E8D57) * c[2];
+
+            uint32_t next[4] = {
+                static_cast<uint32_t>(p1 >> 32) ^ c[1] ^ k[0],
+                static_cast<uint32_t>(p1),
+                static_cast<uint32_t>(p0 >> 32) ^ c[3] ^ k[1],
+                static_cast<uint32_t>(p0) };
+
+            c[0] = next[0];
+            c[1] = next[1];
+            c[2] = next[2];
+            c[3] = next[3];
+
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+        }
+
+        out[0] = c[0];
+        out[1] = c[1];
+        out[2] = c[2];
+        out[3] = c[3];
+    }
+
+    uint32_t operator ()()
+    {
+        if (m_used == 4)
+        {
+            uint32_t counter[4] = {
+                static_cast<uint32_t>(m_block), static_cast<uint32_t>(m_block >> 32),
+                m_stream[0], m_stream[1] };
+            Block(counter, m_key, m_out);
+            ++m_block;
+            m_used = 0;
+        }
+
+        return m_out[m_used++];
+    }
+
+    // uniform on [0, 1), 53 bits
+    double Uniform()
+    {
+        uint64_t high = (*this)() >> 5;
+        uint64_t low = (*this)() >> 6;
+        return (high * 67108864.0 + low) / 9007199254740992.0;
+    }
+
+    // standard normal, Box - Muller
+    double Normal()
+    {
+        auto u1 = 1 - Uniform(); // (0, 1]
+        auto u2 = Uniform();
+        return sqrt(-2 * log(u1)) * cos(2 * M_PI * u2);
+    }
+
+private:
+    uint32_t m_key[2];
+    uint32_t m_stream[2];
+    uint64_t m_block;
+    uint32_t m_out[4];
+    int m_used;
+};
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <iterator>
+
+// Random access iterator over a range that produces its elements from their
+// index, range[index], rather than storing them.  Dereferencing returns the
+// element by value.
+template<typename Range>
+class IndexIterator
+{
+public:
+    using iterator_category = std::random_access_iterator_tag;
+    using value_type = typename Range::value_type;
+    using difference_type = std::ptrdiff_t;
+    using pointer = value_type const*;
+    using reference = value_type;
+
+    IndexIterator() : m_range(nullptr), m_index(0) {}
+    IndexIterator(Range const* range, size_t index) : m_range(range), m_index(index) {}
+
+    value_type operator *() const { return (*m_range)[m_index]; }
+    value_type operator [](difference_type n) const { return (*m_range)[m_index + n]; }
+
+    IndexIterator& operator ++() { ++m_index; return *this; }
+    IndexIterator& operator --() { --m_index; return *this; }
+    IndexIterator operator ++(int) { auto old = *this; ++m_index; return old; }
+    IndexIterator operator --(int) { auto old = *this; --m_index; return old; }
+
+    IndexIterator& operator +=(difference_type n) { m_index += n; return *this; }
+    IndexIterator& operator -=(difference_type n) { m_index -= n; return *this; }
+    IndexIterator operator +(difference_type n) const { return IndexIterator(m_range, m_index + n); }
+    IndexIterator operator -(difference_type n) const { return IndexIterator(m_range, m_index - n); }
+    difference_type operator -(IndexIterator const& rhs) const
+    {
+        return static_cast<difference_type>(m_index) - static_cast<difference_type>(rhs.m_index);
+    }
+
+    bool operator ==(IndexIterator const& rhs) const { return m_index == rhs.m_index; }
+    bool operator !=(IndexIterator const& rhs) const { return m_index != rhs.m_index; }
+    bool operator <(IndexIterator const& rhs) const { return m_index < rhs.m_index; }
+    bool operator >(IndexIterator const& rhs) const { return m_index > rhs.m_index; }
+    bool operator <=(IndexIterator const& rhs) const { return m_index <= rhs.m_index; }
+    bool operator >=(IndexIterator const& rhs) const { return m_index >= rhs.m_index; }
+
+private:
+    Range const* m_range;
+    size_t m_index;
+};
@@ -0,0 +1,141 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+#include "ConfigHelpers.h"
+#include "LensGeometry.h"
+
+using namespace jsonHelper;
+
+void WriteLensGeometry(std::string const& filename, std::vector<LensRecord> const& lenses)
+{
+    FILE* file;
+    fopen_s(&file, filename.c_str(), "wb");
+    if (!file)
+    {
+        throw "File not opened";
+    }
+
+    bool written = fwrite(LensGeometryFile::Tag(), 1, LensGeometryFile::TagSize, file) == LensGeometryFile::TagSize &&
+        fwrite(lenses.data(), sizeof(LensRecord), lenses.size(), file) == lenses.size();
+    fclose(file);
+
+    if (!written)
+    {
+        throw "File not written";
+    }
+}
+
+namespace
+{
+    void ReadTriple(json const& j, char const* name, double (&xyz)[3])
+    {
+        auto at = j.find(name);
+        if (at == j.end())
+        {
+            return;
+        }
+
+        auto values = at->get<std::vector<double>>();
+        if (values.size() != 3)
+        {
+            throw "'CheckData:InputError', ' lens center and axis are x, y, z'";
+        }
+
+        std::copy(values.begin(), values.end(), xyz);
+    }
+
+    std::vector<LensRecord> ReadJsonLenses(std::ifstream& input)
+    {
+        json j;
+        input >> j;
+        if (!j.is_array())
+        {
+            throw "'CheckData:InputError', ' lens geometry json is not an array of lenses'";
+        }
+
+        std::vector<LensRecord> lenses;
+        for (auto const& entry : j)
+        {
+            if (entry.find("center") == entry.end() || entry.find("diameter") == entry.end())
+            {
+                throw "'CheckData:InputError', ' each lens needs a center and a diameter'";
+            }
+
+            LensRecord lens = { { 0, 0, 0 }, { 0, 0, 1 }, 0, 0 };
+            ReadTriple(entry, "center", lens.center);
+            ReadTriple(entry, "axis", lens.axis);
+            lens.diameter = GetValueOrDefault(entry, "diameter", lens.diameter);
+            lens.phase = GetValueOrDefault(entry, "phase", lens.phase);
+            lenses.push_back(lens);
+        }
+
+        return lenses;
+    }
+
+    std::vector<LensRecord> ReadCsvLenses(std::ifstream& input)
+    {
+        std::vector<LensRecord> lenses;
+        std::string line;
+        bool first = true;
+        while (std::getline(input, line))
+        {
+            auto start = line.find_first_not_of(" \t\r");
+            if (start == std::string::npos || line[start] == '#')
+            {
+                continue;
+            }
+
+            std::replace(line.begin(), line.end(), ',', ' ');
+            std::istringstream fields(line);
+
+            LensRecord lens;
+            fields >> lens.center[0] >> lens.center[1] >> lens.center[2]
+                >> lens.axis[0] >> lens.axis[1] >> lens.axis[2]
+                >> lens.diameter >> lens.phase;
+
+            if (fields.fail())
+            {
+                // a header line naming the columns
+                if (first)
+                {
+                    first = false;
+                    continue;
+                }
+
+                throw "'CheckData:InputError', ' lens line is not x, y, z, axis x, y, z, diameter, phase'";
+            }
+
+            first = false;
+            lenses.push_back(lens);
+        }
+
+        return lenses;
+    }
+}
+
+void ImportLensGeometry(std::string const& inputFile, std::string const& outputFile)
+{
+    std::ifstream input(inputFile);
+    if (!input)
+    {
+        throw "File not opened";
+    }
+
+    auto extension = inputFile.substr(std::min(inputFile.size(), inputFile.find_last_of('.')));
+    std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+
+    auto lenses = (extension == ".json") ? ReadJsonLenses(input) : ReadCsvLenses(input);
+    for (auto const& lens : lenses)
+    {
+        if (!(lens.diameter > 0))
+        {
+            throw "'CheckData:InputError', ' lens diameters must be positive'";
+        }
+    }
+
+    WriteLensGeometry(outputFile, lenses);
+    printf("%d lenses written to %s\n", static_cast<int>(lenses.size()), outputFile.c_str());
+}
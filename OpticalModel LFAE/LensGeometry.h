@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "MappedFile.h"
+
+// Binary lens geometry for arrays that are not the hexagonal ArraySetup
+// layout - conformal or sparse arrays with individual lenses.  The file is
+// the 8 byte tag "LFAELENS" followed by one LensRecord per lens, in
+// little-endian doubles with no padding.  Records are 8 byte aligned in the
+// mapping, so they are read in place.
+struct LensRecord
+{
+    double center[3];   // optical center, meters
+    double axis[3];     // optical axis; need not be normalized
+    double diameter;    // lens diameter, meters
+    double phase;       // piston phase, radians
+};
+
+static_assert(sizeof(LensRecord) == 8 * sizeof(double), "lens records are packed doubles");
+
+class LensGeometryFile
+{
+public:
+    explicit LensGeometryFile(std::string const& filename) : m_file(filename)
+    {
+        if (m_file.size() < TagSize || memcmp(m_file.data(), Tag(), TagSize) != 0 ||
+            (m_file.size() - TagSize) % sizeof(LensRecord) != 0)
+        {
+            throw "'CheckData:InputError', ' not a lens geometry file'";
+        }
+    }
+
+    size_t size() const
+    {
+        return (m_file.size() - TagSize) / sizeof(LensRecord);
+    }
+
+    LensRecord const& operator [](size_t lens) const
+    {
+        return reinterpret_cast<LensRecord const*>(m_file.data() + TagSize)[lens];
+    }
+
+    char const* data() const { return m_file.data(); }
+    size_t bytes() const { return m_file.size(); }
+
+    static char const* Tag() { return "LFAELENS"; }
+    static const size_t TagSize = 8;
+
+private:
+    MappedFile m_file;
+};
+
+void WriteLensGeometry(std::string const& filename, std::vector<LensRecord> const& lenses);
+
+// Converts a lens list to the binary format.  A .json file is an array of
+//   { "center": [x, y, z], "axis": [x, y, z], "diameter": d, "phase": p }
+// (axis defaults to +z and phase to 0); anything else is read as CSV lines of
+//   x, y, z, axis x, axis y, axis z, diameter, phase
+// with an optional header line and # comments.
+void ImportLensGeometry(std::string const& inputFile, std::string const& outputFile);
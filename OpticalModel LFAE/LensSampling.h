@@ -0,0 +1,106 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+
+#include <assert.h>
+#include <math.h>
+#include <stdint.h>
+#include <vector>
+#include "Vector3.h"
+
+// Alternatives to ClosePackCenters for discretizing a lens aperture.
+// Both samplers place npoints equal-area samples inside a circle of radius
+// outer_rad centered at the origin, leaving the z - values at 0 so the result
+// can be used as the same lens template that ClosePackCenters builds.
+//
+// Every sample represents an equal share of the aperture area, pi R^2 / N.
+// discr_rad is returned as the radius of a close-packed circle whose hexagonal
+// cell (2 sqrt(3) a^2) covers that same area, so the element factor in
+// ShineOnTargetPoint is comparable between samplers.
+
+template<typename T>
+T EqualAreaDiscretizationRadius(int npoints, T outer_rad)
+{
+    assert(npoints > 0);
+    auto cellArea = M_PI * outer_rad * outer_rad / npoints;
+    return static_cast<T>(sqrt(cellArea / (2 * sqrt(3))));
+}
+
+// Fibonacci (golden angle) spiral; sample i sits at the center of the i-th
+// equal-area annulus, rotated by the golden angle from the previous sample
+template<typename T>
+std::vector<Point3<T>> FibonacciSpiralCenters(int npoints, T outer_rad, T& discr_rad)
+{
+    discr_rad = EqualAreaDiscretizationRadius(npoints, outer_rad);
+
+    std::vector<Point3<T>> discr_ctr;
+    discr_ctr.reserve(npoints);
+
+    auto goldenAngle = M_PI * (3 - sqrt(5));
+    for (int i_pt = 0; i_pt < npoints; ++i_pt)
+    {
+        auto radius = outer_rad * sqrt((i_pt + 0.5) / npoints);
+        auto theta = i_pt * goldenAngle;
+
+        discr_ctr.push_back(Point3<T>(
+            static_cast<T>(radius * cos(theta)),
+            static_cast<T>(radius * sin(theta)),
+            static_cast<T>(0)));
+    }
+
+    return discr_ctr;
+}
+
+// Two dimensional Sobol sequence
+// The first dimension is the base 2 van der Corput sequence, the second uses
+// the direction numbers for the primitive polynomial x + 1
+inline void Sobol2D(uint32_t index, double& u, double& v)
+{
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t directionX = 1u << 31;
+    uint32_t directionY = 1u << 31;
+
+    for (; index != 0; index >>= 1)
+    {
+        if (index & 1)
+        {
+            x ^= directionX;
+            y ^= directionY;
+        }
+
+        directionX >>= 1;
+        directionY ^= directionY >> 1;
+    }
+
+    u = x / 4294967296.0;
+    v = y / 4294967296.0;
+}
+
+// Sobol points mapped onto the disk with the equal-area map
+// r = R sqrt(u), theta = 2 pi v
+template<typename T>
+std::vector<Point3<T>> SobolDiskCenters(int npoints, T outer_rad, T& discr_rad)
+{
+    discr_rad = EqualAreaDiscretizationRadius(npoints, outer_rad);
+
+    std::vector<Point3<T>> discr_ctr;
+    discr_ctr.reserve(npoints);
+
+    for (int i_pt = 0; i_pt < npoints; ++i_pt)
+    {
+        double u;
+        double v;
+        Sobol2D(static_cast<uint32_t>(i_pt), u, v);
+
+        auto radius = outer_rad * sqrt(u);
+        auto theta = 2 * M_PI * v;
+
+        discr_ctr.push_back(Point3<T>(
+            static_cast<T>(radius * cos(theta)),
+            static_cast<T>(radius * sin(theta)),
+            static_cast<T>(0)));
+    }
+
+    return discr_ctr;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+// Read-only view of an entire file mapped into memory
+// Pages are only read from disk as they are touched, so files much larger
+// than the working set can be walked through in chunks.
+// (Files larger than 2 GB need the x64 build.)
+class MappedFile
+{
+public:
+    explicit MappedFile(std::string const& filename);
+    ~MappedFile();
+
+    MappedFile(MappedFile const&) = delete;
+    MappedFile& operator =(MappedFile const&) = delete;
+
+    char const* data() const { return m_data; }
+    size_t size() const { return m_size; }
+
+private:
+    char const* m_data;
+    size_t m_size;
+    void* m_file;
+    void* m_mapping;
+};
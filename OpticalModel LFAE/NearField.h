@@ -0,0 +1,445 @@
+#pragma once
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "Array2D.h"
+#include "ConfigHelpers.h"
+#include "DataType.h"
+#include "Matrix3x3.h"
+#include "TargetGeometry.h"
+#include "TargetSource.h"
+
+// A square window on the target plane, gmax / npts style, centered at
+// (center_x, center_y)
+struct RegionOfInterest
+{
+    floatType center_x = 0;
+    floatType center_y = 0;
+    floatType extent = 1;
+    int npts = 11;
+};
+
+inline void to_json(nlohmann::json& j, const RegionOfInterest& r)
+{
+    j = nlohmann::json
+    {
+        { "center_x", r.center_x },
+        { "center_y", r.center_y },
+        { "extent", r.extent },
+        { "npts", r.npts },
+    };
+}
+
+inline void from_json(const nlohmann::json& j, RegionOfInterest& r)
+{
+    RegionOfInterest defaults;
+    r.center_x = jsonHelper::GetValueOrDefault(j, "center_x", defaults.center_x);
+    r.center_y = jsonHelper::GetValueOrDefault(j, "center_y", defaults.center_y);
+    r.extent = jsonHelper::GetValueOrDefault(j, "extent", defaults.extent);
+    r.npts = jsonHelper::GetValueOrDefault(j, "npts", defaults.npts);
+}
+
+// Summary of the target intensity with lens, and other_lens, switched off;
+// -1 for no lens, so the intact array is (-1, -1)
+struct FailureCase
+{
+    int lens;
+    int other_lens;
+    floatType peak;
+    floatType power;
+    floatType bucket_power;
+};
+
+// Rigid transform that places the lens template: rotation about the origin,
+// then translation to the optical center.  An untilted lens has the identity
+// rotation, which gives exactly template + center.
+struct LensTransform
+{
+    Matrix3x3<floatType> rotation;      // scaled with the lens diameter
+    pointType center;
+    floatType discr_rad;                // the template's, scaled likewise
+
+    pointType Apply(pointType const& t) const
+    {
+        return pointType(
+            rotation.A() * t.X() + rotation.B() * t.Y() + rotation.C() * t.Z() + center.X(),
+            rotation.P() * t.X() + rotation.Q() * t.Y() + rotation.R() * t.Z() + center.Y(),
+            rotation.U() * t.X() + rotation.V() * t.Y() + rotation.W() * t.Z() + center.Z());
+    }
+};
+
+class NearField
+{
+public:
+    //% Declared System Configuration Details
+    //%= ==================================== =
+    //%   Dlens = diameter of each lens, meters
+    floatType Dlens = 0.5;
+
+    //%   lens_pitch = lens pitch, meters; center - to - center distance from the
+    //%   center lens to a lens in the first 'shell'
+    floatType lens_pitch = 0.5;
+
+    //
+    //%   n_lens_shells = number of lens 'shells' on one radius of the array, not
+    //%   including the center lens
+    int n_lens_shells = 3;
+
+    //%   lens_geometry_file = optional binary lens list (see LensGeometry.h)
+    //%   used in place of the n_lens_shells hexagonal array; each lens has
+    //%   its own center, optical axis, diameter and piston phase, and its
+    //%   template is the Dlens one scaled to its diameter
+    std::string lens_geometry_file;
+
+    //%   lens_list_file = CSV or JSON lens list that
+    //%   NearField_ImportLensGeometry converts to a lens_geometry_file (see
+    //%   ImportLensGeometry for the formats)
+    std::string lens_list_file;
+
+    //
+    //%   lambda = nominal emitter wavelength, meters
+    floatType lambda = static_cast<floatType>(1.064e-6);
+
+    //%   Demitter = fiber tip diameter of all emitters, meters
+    floatType Demitter = static_cast<floatType>(12.5e-6);
+
+    //%   NAemitter = Numerical Aperture of all fiber tips
+    floatType NAemitter = static_cast<floatType>(0.22);
+
+    //%   emitter_apodization = illumination of each lens by its fiber tip
+    //%       "uniform"  - every lens point has amplitude 1
+    //%       "gaussian" - the Gaussian beam from the Demitter mode at a lens
+    //%                    that fills the NAemitter cone (see Apodization.h)
+    //%   apodization_threshold = lens points below this fraction of the
+    //%   center amplitude are dropped; SetupArray prints the bound on the
+    //%   change in the field this makes
+    std::string emitter_apodization = "uniform";
+    floatType apodization_threshold = 0;
+
+    //%   FOV = optical(angular) field of view for all lenses, radians
+    //%         From Mission Parameters, e.g., produce a 1 m beam at 100 km
+    floatType FOV = static_cast<floatType>(1e-5);
+
+    //%   fov_margin = when positive, R00 skips every lens for a tile of
+    //%   target points that lies wholly outside fov_margin * FOV / 2 of the
+    //%   lens optical axis; 0 keeps every lens for every point
+    floatType fov_margin = 0;
+
+    //%   n_medium = index of refraction of the medium(1 in vacuum of space)
+    floatType n_medium = 1;
+
+    //%   target_surf_dist = distance of the target surface from the nominal
+    //%   emitter array center, meters
+    floatType target_surf_dist = 1000;
+
+    //%   ndiscr = number of 'shells' on one radius of a lens element, not
+    //%   including the center point
+    int n_discr_shells = 5;
+
+    //%   lens_sampling = lens discretization scheme
+    //%       "closepack" - close-packed grid of n_discr_shells shells
+    //%       "fibonacci" - golden angle spiral of n_lens_sample_pts points
+    //%       "sobol"     - Sobol sequence of n_lens_sample_pts points
+    std::string lens_sampling = "closepack";
+
+    //%   n_lens_sample_pts = number of points on each lens for the
+    //%   low-discrepancy samplers
+    int n_lens_sample_pts = 100;
+
+    //%   lens_point_order = order the points of the lens template are stored
+    //%   and summed in; "native" (as built), "morton" or "hilbert"
+    std::string lens_point_order = "native";
+
+    int npts = 100;
+    floatType gmax = 3;
+
+    //%   target_geometry = layout of the target sample points
+    //%       "grid"  - npts x npts square grid over [-gmax, gmax]
+    //%       "line"  - npts point line cut at target_angle through the center
+    //%       "polar" - npts rings out to gmax, n_theta spokes per ring,
+    //%                 covering 1 / polar_symmetry of the circle
+    //%       "hex"   - hexagonal grid with the coverage of the square grid
+    std::string target_geometry = "grid";
+    floatType target_angle = 0;
+    int n_theta = 60;
+    int polar_symmetry = 1;
+
+    //%   target_order = order the target points are handed to the threads;
+    //%   "native" (row major), "morton" or "hilbert" over (row, col).  The
+    //%   intensity is always returned row major.
+    std::string target_order = "native";
+
+    //%   target_file = optional non-planar target read from disk, evaluated
+    //%   by ShineOnTargetSource in chunks of target_chunk_size points
+    //%       target_file_format "points" - binary list of x, y, z doubles
+    //%       target_file_format "stl"    - binary STL mesh, at facet centers
+    std::string target_file;
+    std::string target_file_format = "points";
+    int target_chunk_size = 65536;
+
+    //%   volume_z_min, volume_z_max, n_volume_slices = target plane distances
+    //%   evaluated together by R00Volume, meters; the footprint of each plane
+    //%   comes from target_geometry
+    floatType volume_z_min = 990;
+    floatType volume_z_max = 1010;
+    int n_volume_slices = 21;
+
+    //%   regions = windows on the target plane evaluated together by
+    //%   R00Regions, e.g. the main lobe, grating lobes and a guard region
+    std::vector<RegionOfInterest> regions;
+
+    //%   tile_cache_dir = existing directory holding computed target tiles
+    //%   for R00Cached; tile_size = (even) number of points on a tile side.
+    //%   R00Cached matches the npts x npts grid exactly for an odd npts; an
+    //%   even npts is shifted by half a point spacing onto the tile lattice
+    std::string tile_cache_dir;
+    int tile_size = 32;
+
+    //%   partial_field_budget_mb = memory for the per-lens fields of a
+    //%   PartialFieldCache; lenses beyond it go to partial_field_spill_file
+    int partial_field_budget_mb = 1024;
+    std::string partial_field_spill_file = "partial_fields.bin";
+
+    //%   phase_configurations = per lens phases (radians), one row per
+    //%   configuration, for NearField_PhaseSweep
+    std::vector<std::vector<floatType>> phase_configurations;
+
+    //%   lens_phases = starting phase of each lens (radians), zero when empty
+    std::vector<floatType> lens_phases;
+
+    //%   metric = target metric for gradients and phase control
+    //%       "peak"     - intensity at the brightest target point
+    //%       "bucket"   - power within bucket_radius of the target center
+    //%       "weighted" - SUM metric_weights(Q) I(Q), a weight per target point
+    std::string metric = "peak";
+    floatType bucket_radius = 0.1;
+    std::vector<floatType> metric_weights;
+
+    //%   SPGD phase control - the detector is a pinhole of bucket_radius at
+    //%   the target center, sampled by spgd_detector_npts x spgd_detector_npts
+    //%   points.  Each iteration perturbs every lens phase by
+    //%   +/- spgd_perturbation, measures the detector on both sides, and
+    //%   steps the phases by spgd_gain times the normalized difference.
+    //%   The starting phases are lens_phases, or random when it is empty.
+    int spgd_iterations = 1000;
+    floatType spgd_gain = 1;
+    floatType spgd_perturbation = 0.1;
+    int spgd_detector_npts = 11;
+    unsigned int spgd_seed = 1;
+
+    //%   retrieval_target = desired intensity at each target point, for
+    //%   Gerchberg - Saxton phase retrieval over retrieval_iterations
+    std::vector<floatType> retrieval_target;
+    int retrieval_iterations = 200;
+
+    //%   failure_pairs = also scan every pair of failed lenses in FailureScan
+    bool failure_pairs = false;
+
+    //%   zernike_coefficients = per lens phase aberration, radians, one row
+    //%   of Noll ordered coefficients (piston, tip, tilt, defocus, ...) per
+    //%   lens; missing rows and terms are zero
+    std::vector<std::vector<floatType>> zernike_coefficients;
+
+    //%   lens_axes = optional optical axis (x, y, z) of each lens; the lens
+    //%   aperture is rotated to be normal to it.  Empty for all along z.
+    std::vector<std::vector<floatType>> lens_axes;
+
+    //%   turbulence phase screens added to phi - n_screens realizations of
+    //%   screen_points x screen_points covering the array, with Fried
+    //%   parameter screen_r0, outer and inner scales (meters, 0 to leave
+    //%   out) and screen_subharmonics levels of low frequencies
+    int n_screens = 10;
+    floatType screen_r0 = 0.05;
+    floatType screen_outer_scale = 10;
+    floatType screen_inner_scale = 0;
+    int screen_points = 256;
+    int screen_subharmonics = 3;
+    uint64_t screen_seed = 1;
+
+    //%   Monte Carlo tolerance study - mc_trials random draws of lens center
+    //%   offsets (mc_center_sigma, meters, per axis), optical axis tilts
+    //%   (mc_tilt_sigma, radians, per axis) and lens piston phase errors
+    //%   (mc_phase_sigma, radians), keyed by (mc_seed, trial, lens)
+    int mc_trials = 1000;
+    uint64_t mc_seed = 1;
+    floatType mc_center_sigma = 1e-6;
+    floatType mc_tilt_sigma = 1e-5;
+    floatType mc_phase_sigma = 0.1;
+
+    //%   transient time stepping - transient_steps steps of transient_dt
+    //%   seconds; each step every lens center jitters about its nominal
+    //%   position (jitter_sigma, meters, per axis), each optical axis drifts
+    //%   at axis_drift_rate (radians per second) in a fixed random direction,
+    //%   and each lens phase is its nominal phase plus noise of
+    //%   phase_noise_sigma (radians), drawn afresh each step; draws are keyed
+    //%   by (transient_seed, step, lens)
+    int transient_steps = 1000;
+    floatType transient_dt = 1e-3;
+    uint64_t transient_seed = 1;
+    floatType jitter_sigma = 1e-7;
+    floatType axis_drift_rate = 1e-6;
+    floatType phase_noise_sigma = 0.01;
+
+    int m_threadCount = 0;
+
+    pointType refplane_anchor;
+    int n_lenses;
+    int n_lens_pts;
+    floatType discr_rad;
+    Array2D<floatType> phi;             // n_lenses x n_lens_pts
+    Array2D<floatType> zernike_basis;   // n_lens_pts x terms, on the template
+    pointVector oa_center;
+    pointVector oa_vector;
+    pointVector discr_ctr;              // lens template, centered at the origin
+    std::vector<floatType> lens_weight; // amplitude of each template point
+    floatType apodization_error = 0;    // |change in U| / coherent sum, from pruning
+    floatType fov_kept_fraction = 1;    // lens / tile pairs summed, of all, from FOV culling
+    std::vector<floatType> lens_scale;  // lens diameter / Dlens
+    std::vector<floatType> lens_piston; // per lens phase from lens_geometry_file
+
+    // The lens points are not stored; lens point i_pt of a lens is its
+    // transform applied to discr_ctr[i_pt], so the geometry is
+    // O(n_lenses + n_lens_pts)
+    std::vector<LensTransform> lens_transform;
+
+    //dataType gmin = -3;
+
+public:
+    Array2D<floatType> R00();
+    Array2D<floatType> R00(TargetGeometry<floatType> const& targetGeometry);
+
+    // Builds the lens discretization for every lens in the array
+    // (oa_center, oa_vector, phi, lens_transform and refplane_anchor)
+    void SetupArray();
+
+    // Replaces the aberration of one lens and updates its row of phi with
+    // one product against zernike_basis
+    void SetZernikeCoefficients(int lens, std::vector<floatType> const& coefficients);
+
+    // Moves a lens to center and points its optical axis along axis,
+    // replacing its transform.
+    // Call UpdateRefplaneAnchor once the lenses have been moved.
+    void MoveLens(int lens, pointType const& center, pointType const& axis);
+    void UpdateRefplaneAnchor();
+
+    floatType ShineOnTargetPoint(pointType const& Qi) const;
+
+    // Same sum, over the given lenses only
+    floatType ShineOnTargetPoint(pointType const& Qi, std::vector<int> const& lenses) const;
+
+    // The lenses whose fov_margin cone reaches any of the points, which must
+    // lie within radius of center
+    void VisibleLenses(pointType const& center, floatType radius, std::vector<int>& lenses) const;
+
+    pointType LensPoint(int lens, int i_pt) const
+    {
+        return lens_transform[lens].Apply(discr_ctr[i_pt]);
+    }
+
+    // The field at Qi from each lens on its own, U_lens(Qi); U has n_lenses
+    // entries, and ShineOnTargetPoint is the norm of their sum
+    void LensFieldsAtPoint(pointType const& Qi, complexType* U) const;
+
+    std::unique_ptr<TargetGeometry<floatType>> MakeTarget() const;
+
+    // Streams the intensity at every point of source to outputFile as doubles
+    void ShineOnTargetSource(TargetSource const& source, std::string const& outputFile);
+
+    std::unique_ptr<TargetSource> MakeTargetSource() const;
+
+    // Evaluates the footprint at each of the given target distances in one
+    // pass; returns one intensity slice per distance
+    std::vector<Array2D<floatType>> R00Volume(TargetGeometry<floatType> const& footprint, std::vector<floatType> const& distances);
+
+    std::vector<floatType> VolumeDistances() const;
+
+    // Evaluates every target in a single scheduling pass over the combined
+    // points; returns one intensity array per target
+    std::vector<Array2D<floatType>> R00Regions(std::vector<std::unique_ptr<TargetGeometry<floatType>>> const& targets);
+
+    std::vector<std::unique_ptr<TargetGeometry<floatType>>> MakeRegionTargets() const;
+
+    // Same window as GridTarget(side, extent, target_surf_dist, centerX,
+    // centerY), assembled from tiles in tile_cache_dir where possible.  The
+    // tiles lie on a lattice through the origin, so a window whose corner is
+    // off the lattice - an even side centered at 0, e.g. the default
+    // npts = 100 - is moved onto it, by up to half a spacing in x and y
+    Array2D<floatType> R00Cached(int side, floatType extent, floatType centerX = 0, floatType centerY = 0);
+
+    // The tile files, in row major tile order, that hold the window of
+    // R00Cached(side, extent, centerX, centerY) - e.g. to clear it from the
+    // cache; files that were never written are listed too
+    std::vector<std::string> CachedTileFiles(int side, floatType extent, floatType centerX = 0, floatType centerY = 0) const;
+
+    // Evaluates target under n_screens turbulence realizations together;
+    // the geometry term of each lens point and target point is computed
+    // once and applied to every realization.  Returns one array per screen.
+    std::vector<Array2D<floatType>> R00Screens(TargetGeometry<floatType> const& target);
+
+    // Runs the mc_trials tolerance draws in parallel and streams one line
+    // of TargetSummary per trial to outputFile, in trial order; prints the
+    // mean, standard deviation, minimum and maximum of each metric
+    void MonteCarlo(TargetGeometry<floatType> const& target, std::string const& outputFile);
+
+    // Steps the array through transient_steps of jitter, drift and phase
+    // noise, moving only the lenses that change, and streams
+    // step, time and the TargetSummary of each step to outputFile; the
+    // array is left at its nominal centers, axes and phases
+    void Transient(TargetGeometry<floatType> const& target, std::string const& outputFile);
+
+    // Intensity summaries for the intact array, each lens failed in turn,
+    // and optionally every pair of failed lenses, from one pass over the
+    // target; lens_phases, when set, is applied to the lens fields
+    std::vector<FailureCase> FailureScan(TargetGeometry<floatType> const& target);
+
+    // Weight of each target point for the configured metric - see
+    // TargetMetric.h; the peak metric is placed at the brightest point of I
+    std::vector<floatType> MetricWeights(TargetGeometry<floatType> const& target, Array2D<floatType> const& I) const;
+
+    // Runs the SPGD control loop on the detector points; returns the
+    // detector metric after each iteration and the final lens phases
+    std::vector<floatType> SimulateSpgd(std::vector<floatType>& phases);
+
+    // Gerchberg - Saxton phase retrieval of the lens phases that best give
+    // the retrieval_target intensity; returns the error of each iterate
+    std::vector<floatType> RetrievePhases(TargetGeometry<floatType> const& target, std::vector<floatType>& phases);
+
+    // Hash of the settings that set the field at a target point - the lens
+    // array, emitter, lens discretization and target distance - and of the
+    // lens geometry file contents
+    uint64_t PhysicsHash() const;
+
+private:
+    pointVector DiscretizeLens(floatType Rlens);
+    void ApodizeLens(floatType Rlens);
+    void ShineOnTiles(TargetGeometry<floatType> const& target, Array2D<floatType>& I);
+    void LoadLensGeometry();
+
+    void UpdateLensPhase(int lens);
+    void PlaceLens(int lens);
+
+    pointType ReferencePlaneNormal(pointType const& Qi) const;
+    void AddLensField(pointType const& Qi, pointType const& refplane_N, int lens, complexType& U) const;
+    complexType LensPointField(floatType discr_rad, floatType sintheta_i, floatType t_i, floatType weight, floatType phase) const;
+
+    floatType k;
+};
+
+// The field at Qi of one discretized lens point, shared by every R00 style
+// sum: the aperture term of a point of radius discr_rad seen at theta_i off
+// the optical axis, times exp(i (k t_i + phase)) for the oblique distance t_i
+// from the lens point to the reference plane.
+inline complexType NearField::LensPointField(floatType discr_rad, floatType sintheta_i, floatType t_i, floatType weight, floatType phase) const
+{
+    const auto i = complexType(0, 1);
+    const auto _2 = complexType(2);
+    const auto _1 = complexType(1);
+
+    return weight * ((exp(i * k * _2 * discr_rad * sintheta_i) - _1) / (i * k * _2 * discr_rad * sintheta_i)) * exp(i * (k * t_i + phase));
+}
+
+void to_json(nlohmann::json& j, const NearField& p);
+void from_json(const nlohmann::json& j, NearField& p);
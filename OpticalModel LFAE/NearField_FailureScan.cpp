@@ -0,0 +1,118 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "Parallel.h"
+#include "TargetMetric.h"
+
+using namespace jsonHelper;
+
+static const auto i = complexType(0, 1);
+
+// Every target point is visited once.  The fields of all of the lenses are
+// found together, and the field with some lenses off is the total minus
+// their fields, so each failure case costs a subtraction per point rather
+// than a full evaluation.  Only the summaries are kept, per thread, and the
+// threads are merged at the end.
+std::vector<FailureCase> NearField::FailureScan(TargetGeometry<floatType> const& target)
+{
+    SetupArray();
+
+    if (!lens_phases.empty() && static_cast<int>(lens_phases.size()) != n_lenses)
+    {
+        throw "'CheckData:InputError', ' lens_phases needs one phase per lens'";
+    }
+
+    std::vector<complexType> weight(n_lenses, complexType(1));
+    for (size_t lens = 0; lens < lens_phases.size(); ++lens)
+    {
+        weight[lens] = exp(i * lens_phases[lens]);
+    }
+
+    std::vector<FailureCase> cases;
+    cases.push_back({ -1, -1, 0, 0, 0 });
+    for (int lens = 0; lens < n_lenses; ++lens)
+    {
+        cases.push_back({ lens, -1, 0, 0, 0 });
+    }
+
+    if (failure_pairs)
+    {
+        for (int lens = 0; lens < n_lenses; ++lens)
+        {
+            for (int other = lens + 1; other < n_lenses; ++other)
+            {
+                cases.push_back({ lens, other, 0, 0, 0 });
+            }
+        }
+    }
+
+    auto bucket = BucketWeights<floatType>(target, 0, 0, bucket_radius);
+    auto const empty = cases;
+    std::mutex merge;
+
+    ParallelFor(target.size(), m_threadCount, [&](size_t begin, size_t end) {
+        auto local = empty;
+        std::vector<complexType> U_lens(n_lenses + 1);
+        U_lens[n_lenses] = 0; // for other_lens == -1
+
+        for (auto q = begin; q < end; ++q)
+        {
+            LensFieldsAtPoint(target.PointAt(q), U_lens.data());
+
+            complexType U = 0;
+            for (int lens = 0; lens < n_lenses; ++lens)
+            {
+                U_lens[lens] *= weight[lens];
+                U += U_lens[lens];
+            }
+
+            for (auto& c : local)
+            {
+                auto off = (c.lens < 0) ? complexType(0) : U_lens[c.lens] + U_lens[(c.other_lens < 0) ? n_lenses : c.other_lens];
+                auto I = std::norm(U - off);
+
+                c.peak = std::max(c.peak, I);
+                c.power += I;
+                c.bucket_power += bucket[q] * I;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(merge);
+        for (size_t c = 0; c < cases.size(); ++c)
+        {
+            cases[c].peak = std::max(cases[c].peak, local[c].peak);
+            cases[c].power += local[c].power;
+            cases[c].bucket_power += local[c].bucket_power;
+        }
+    });
+
+    return cases;
+}
+
+void NearField_FailureScan(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto target = n.MakeTarget();
+    auto cases = n.FailureScan(*target);
+
+    FILE* file;
+    fopen_s(&file, outputFile.c_str(), "wt");
+    if (!file)
+    {
+        throw "File not opened";
+    }
+
+    for (auto const& c : cases)
+    {
+        fprintf(file, "%d, %d, %f, %f, %f\n", c.lens, c.other_lens, c.peak, c.power, c.bucket_power);
+    }
+
+    fclose(file);
+}
@@ -0,0 +1,123 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <atomic>
+#include <vector>
+
+#include "NearField.h"
+#include "Parallel.h"
+#include "SpaceFillingCurve.h"
+#include "VectorMath.h"
+
+using namespace VectorMath;
+
+namespace
+{
+    // target points per side of a culling tile
+    const int TileSide = 16;
+}
+
+floatType NearField::ShineOnTargetPoint(pointType const& Qi, std::vector<int> const& lenses) const
+{
+    auto refplane_N = ReferencePlaneNormal(Qi);
+
+    complexType U;
+    for (auto lens : lenses)
+    {
+        AddLensField(Qi, refplane_N, lens, U);
+    }
+
+    return std::norm(U);
+}
+
+// A lens point P is within Rlens * lens_scale of the lens center C, and a
+// target point within radius of center, so the direction from P to the point
+// is within asin((R + radius) / |center - C|) of the direction from C to
+// center.  The lens is dropped only when even that closest direction is
+// outside the cone, so no pair inside the cone is ever lost.
+void NearField::VisibleLenses(pointType const& center, floatType radius, std::vector<int>& lenses) const
+{
+    auto halfAngle = fov_margin * FOV / 2;
+
+    lenses.clear();
+    for (int lens = 0; lens < n_lenses; ++lens)
+    {
+        auto d = center - oa_center[lens];
+        auto distance = d.Norm();
+        auto spread = Dlens / 2 * lens_scale[lens] + radius;
+        if (spread >= distance)
+        {
+            lenses.push_back(lens);
+            continue;
+        }
+
+        auto alpha = acos(std::min(std::max(DotProduct(oa_vector[lens], d) / distance, -1.0), 1.0));
+        if (alpha - asin(spread / distance) <= halfAngle)
+        {
+            lenses.push_back(lens);
+        }
+    }
+}
+
+// R00 with FOV culling.  The target is cut into TileSide x TileSide tiles
+// of (row, col), taken by the threads in target_order; the visible lenses
+// are found once per tile, and every point of the tile sums over just those
+// lenses with no further tests in the lens point loop.
+void NearField::ShineOnTiles(TargetGeometry<floatType> const& target, Array2D<floatType>& I)
+{
+    auto tileRows = (target.rows() + TileSide - 1) / TileSide;
+    auto tileCols = (target.cols() + TileSide - 1) / TileSide;
+    auto order = GridCurveOrder(tileRows, tileCols, target_order);
+
+    std::atomic<size_t> pairs(0);
+
+    ParallelFor(order.size(), m_threadCount, [&](size_t begin, size_t end) {
+        std::vector<int> lenses;
+        std::vector<pointType> points;
+        size_t visible = 0;
+
+        for (auto i = begin; i < end; ++i)
+        {
+            auto row0 = static_cast<int>(order[i] / tileCols) * TileSide;
+            auto col0 = static_cast<int>(order[i] % tileCols) * TileSide;
+            auto rows = std::min(TileSide, target.rows() - row0);
+            auto cols = std::min(TileSide, target.cols() - col0);
+
+            // bounding sphere of the tile's points
+            points.clear();
+            pointType center;
+            for (int row = row0; row < row0 + rows; ++row)
+            {
+                for (int col = col0; col < col0 + cols; ++col)
+                {
+                    points.push_back(target.Point(row, col));
+                    center = center + points.back();
+                }
+            }
+            center = center / static_cast<floatType>(points.size());
+
+            floatType radius = 0;
+            for (auto const& Qi : points)
+            {
+                radius = std::max(radius, (Qi - center).Norm());
+            }
+
+            VisibleLenses(center, radius, lenses);
+            visible += lenses.size();
+
+            auto tile = I.Window(row0, col0, rows, cols);
+            auto Qi = points.begin();
+            for (int row = 0; row < rows; ++row)
+            {
+                for (int col = 0; col < cols; ++col, ++Qi)
+                {
+                    tile(row, col) = ShineOnTargetPoint(*Qi, lenses);
+                }
+            }
+        }
+
+        pairs += visible;
+    });
+
+    fov_kept_fraction = static_cast<floatType>(pairs) / (order.size() * n_lenses);
+}
@@ -0,0 +1,51 @@
+#include "stdafx.h"
+
+#include <vector>
+
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "PartialFieldCache.h"
+#include "TargetMetric.h"
+#include "WriteToCSV.h"
+
+using namespace jsonHelper;
+
+std::vector<floatType> NearField::MetricWeights(TargetGeometry<floatType> const& target, Array2D<floatType> const& I) const
+{
+    if (metric == "peak")
+    {
+        return PeakWeights(I);
+    }
+
+    if (metric == "bucket")
+    {
+        return BucketWeights<floatType>(target, 0, 0, bucket_radius);
+    }
+
+    if (metric == "weighted")
+    {
+        if (metric_weights.size() != target.size())
+        {
+            throw "'CheckData:InputError', ' metric_weights needs one weight per target point'";
+        }
+
+        return metric_weights;
+    }
+
+    throw "'CheckData:InputError', ' unknown metric'";
+}
+
+void NearField_Gradient(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto target = n.MakeTarget();
+    PartialFieldCache cache(n, *target);
+
+    std::vector<floatType> gradient;
+    auto metric = cache.MetricGradient(n.MetricWeights(*target, cache.Intensity()), gradient);
+    printf("%s metric %g\n", n.metric.c_str(), metric);
+
+    WriteToCSV(outputFile, gradient);
+}
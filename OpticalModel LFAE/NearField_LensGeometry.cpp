@@ -0,0 +1,58 @@
+#include "stdafx.h"
+
+#include "LensGeometry.h"
+#include "NearField.h"
+#include "NearField_R00.h"
+
+using namespace jsonHelper;
+
+// oa_center, oa_vector, lens_scale and lens_piston for every lens of
+// lens_geometry_file, read straight from the mapped records
+void NearField::LoadLensGeometry()
+{
+    LensGeometryFile geometry(lens_geometry_file);
+    if (geometry.size() == 0)
+    {
+        throw "'CheckData:InputError', ' lens_geometry_file has no lenses'";
+    }
+
+    n_lenses = static_cast<int>(geometry.size());
+    oa_center.resize(n_lenses);
+    oa_vector.resize(n_lenses);
+    lens_scale.resize(n_lenses);
+    lens_piston.resize(n_lenses);
+
+    for (int lens = 0; lens < n_lenses; ++lens)
+    {
+        auto const& record = geometry[lens];
+
+        oa_center[lens] = pointType(record.center[0], record.center[1], record.center[2]);
+        oa_vector[lens] = pointType(record.axis[0], record.axis[1], record.axis[2]);
+        if (!(oa_vector[lens].Norm() > 0))
+        {
+            throw "'CheckData:InputError', ' lens axis has no direction'";
+        }
+        oa_vector[lens].Normalize();
+
+        if (!(record.diameter > 0))
+        {
+            throw "'CheckData:InputError', ' lens diameters must be positive'";
+        }
+
+        lens_scale[lens] = static_cast<floatType>(record.diameter / Dlens);
+        lens_piston[lens] = static_cast<floatType>(record.phase);
+    }
+}
+
+void NearField_ImportLensGeometry(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    if (n.lens_list_file.empty())
+    {
+        throw "'CheckData:InputError', ' lens_list_file is not set'";
+    }
+
+    ImportLensGeometry(n.lens_list_file, outputFile);
+}
@@ -0,0 +1,156 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "CounterRng.h"
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "Parallel.h"
+#include "TargetMetric.h"
+#include "VectorMath.h"
+
+using namespace jsonHelper;
+using namespace VectorMath;
+
+namespace
+{
+    // running mean and variance (Welford), fed in trial order
+    struct RunningStats
+    {
+        int count = 0;
+        floatType mean = 0;
+        floatType m2 = 0;
+        floatType min = std::numeric_limits<floatType>::max();
+        floatType max = std::numeric_limits<floatType>::lowest();
+
+        void Add(floatType value)
+        {
+            ++count;
+            auto delta = value - mean;
+            mean += delta / count;
+            m2 += delta * (value - mean);
+            min = std::min(min, value);
+            max = std::max(max, value);
+        }
+
+        floatType StandardDeviation() const
+        {
+            return (count > 1) ? sqrt(m2 / (count - 1)) : 0;
+        }
+    };
+
+    // trials run in batches, and each batch is written before the next
+    // starts, so the output streams without holding every trial
+    const int BatchTrials = 256;
+}
+
+// Every trial starts from the nominal array and draws its own
+// misalignments from Philox4x32(mc_seed, trial, lens) - the tilts turn the
+// nominal optical axis of each lens - then evaluates the target on one
+// thread.  Nothing a trial computes depends on which thread runs it, and the
+// statistics are accumulated in trial order, so the output is bit-identical
+// for any m_threadCount.
+void NearField::MonteCarlo(TargetGeometry<floatType> const& target, std::string const& outputFile)
+{
+    if (mc_trials <= 0)
+    {
+        throw "'CheckData:InputError', ' mc_trials must be positive'";
+    }
+
+    SetupArray();
+
+    auto bucket = BucketWeights<floatType>(target, 0, 0, bucket_radius);
+
+    FILE* file;
+    fopen_s(&file, outputFile.c_str(), "wt");
+    if (!file)
+    {
+        throw "File not opened";
+    }
+
+    RunningStats stats[5];
+    std::vector<TargetSummary<floatType>> summaries(std::min(BatchTrials, mc_trials));
+
+    for (int batchBegin = 0; batchBegin < mc_trials; batchBegin += BatchTrials)
+    {
+        auto count = std::min(BatchTrials, mc_trials - batchBegin);
+
+        ParallelFor(count, m_threadCount, [&](size_t begin, size_t end) {
+            // one copy per worker; every trial moves every lens and sets
+            // every phase row afresh from the nominal array
+            NearField perturbed = *this;
+
+            for (auto t = begin; t < end; ++t)
+            {
+                auto trial = static_cast<uint32_t>(batchBegin + t);
+
+                for (int lens = 0; lens < n_lenses; ++lens)
+                {
+                    Philox4x32 rng(mc_seed, trial, static_cast<uint32_t>(lens));
+                    auto dx = mc_center_sigma * rng.Normal();
+                    auto dy = mc_center_sigma * rng.Normal();
+                    auto dz = mc_center_sigma * rng.Normal();
+                    auto tiltX = mc_tilt_sigma * rng.Normal();
+                    auto tiltY = mc_tilt_sigma * rng.Normal();
+                    auto phase = mc_phase_sigma * rng.Normal();
+
+                    perturbed.MoveLens(lens, oa_center[lens] + pointType(dx, dy, dz),
+                        TiltAxis(oa_vector[lens], tan(tiltX), tan(tiltY)));
+
+                    auto nominal = phi[lens];
+                    auto row = perturbed.phi[lens];
+                    for (int pt = 0; pt < row.size(); ++pt)
+                    {
+                        row[pt] = nominal[pt] + phase;
+                    }
+                }
+
+                perturbed.UpdateRefplaneAnchor();
+
+                Array2D<floatType> I(target.rows(), target.cols());
+                for (size_t q = 0; q < target.size(); ++q)
+                {
+                    *(I.begin() + q) = perturbed.ShineOnTargetPoint(target.PointAt(q));
+                }
+
+                summaries[t] = Summarize(target, I, bucket);
+            }
+        });
+
+        for (int t = 0; t < count; ++t)
+        {
+            auto const& s = summaries[t];
+            fprintf(file, "%d, %.17g, %.17g, %.17g, %.17g, %.17g\n",
+                batchBegin + t, s.peak, s.power, s.bucket_power, s.centroid_x, s.centroid_y);
+
+            stats[0].Add(s.peak);
+            stats[1].Add(s.power);
+            stats[2].Add(s.bucket_power);
+            stats[3].Add(s.centroid_x);
+            stats[4].Add(s.centroid_y);
+        }
+
+        fflush(file);
+    }
+
+    fclose(file);
+
+    char const* names[] = { "peak", "power", "bucket_power", "centroid_x", "centroid_y" };
+    printf("%d trials\n%-14s %14s %14s %14s %14s\n", mc_trials, "metric", "mean", "std", "min", "max");
+    for (int metric = 0; metric < 5; ++metric)
+    {
+        printf("%-14s %14.6g %14.6g %14.6g %14.6g\n", names[metric],
+            stats[metric].mean, stats[metric].StandardDeviation(), stats[metric].min, stats[metric].max);
+    }
+}
+
+void NearField_MonteCarlo(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto target = n.MakeTarget();
+    n.MonteCarlo(*target, outputFile);
+}
@@ -0,0 +1,201 @@
+#include "stdafx.h"
+
+#include <chrono>
+#include <math.h>
+#include <vector>
+
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "PartialFieldCache.h"
+#include "WriteToCSV.h"
+
+using namespace jsonHelper;
+
+namespace
+{
+    // In place Cholesky factor L L^H of the n x n Hermitian matrix G
+    void CholeskyFactor(std::vector<complexType>& G, int n)
+    {
+        for (int col = 0; col < n; ++col)
+        {
+            auto diagonal = std::real(G[col * n + col]);
+            for (int k = 0; k < col; ++k)
+            {
+                diagonal -= std::norm(G[col * n + k]);
+            }
+
+            if (diagonal <= 0)
+            {
+                throw "'CheckData:InputError', ' lens fields are linearly dependent on the target'";
+            }
+
+            diagonal = sqrt(diagonal);
+            G[col * n + col] = diagonal;
+
+            for (int row = col + 1; row < n; ++row)
+            {
+                auto sum = G[row * n + col];
+                for (int k = 0; k < col; ++k)
+                {
+                    sum -= G[row * n + k] * std::conj(G[col * n + k]);
+                }
+
+                G[row * n + col] = sum / diagonal;
+            }
+        }
+    }
+
+    // Solves L L^H x = b in place, with L from CholeskyFactor
+    void CholeskySolve(std::vector<complexType> const& L, int n, std::vector<complexType>& b)
+    {
+        for (int row = 0; row < n; ++row)
+        {
+            for (int k = 0; k < row; ++k)
+            {
+                b[row] -= L[row * n + k] * b[k];
+            }
+
+            b[row] /= L[row * n + row];
+        }
+
+        for (int row = n - 1; row >= 0; --row)
+        {
+            for (int k = row + 1; k < n; ++k)
+            {
+                b[row] -= std::conj(L[k * n + row]) * b[k];
+            }
+
+            b[row] /= L[row * n + row];
+        }
+    }
+}
+
+// Gerchberg - Saxton between the lens phases and the target plane.  Each
+// iteration propagates the lenses forward to the target, keeps the phase of
+// the target field but replaces its amplitude with the desired one, and
+// propagates back; the constraint in the lens plane is that every lens is a
+// unit amplitude emitter, so only the phase of its back propagated field is
+// kept.  Both propagations go through the lens fields of a PartialFieldCache.
+//
+// Neighbouring lenses light the target with strongly overlapping fields, so
+// the plain adjoint is a poor inverse and the iteration wanders.  The back
+// propagation is therefore the least squares one, with the n_lenses x
+// n_lenses Gram matrix of the lens fields factored once up front.
+//
+// The error is the rms difference between the normalized achieved and
+// desired amplitudes, so the overall power does not matter.
+std::vector<floatType> NearField::RetrievePhases(TargetGeometry<floatType> const& target, std::vector<floatType>& phases)
+{
+    if (retrieval_target.size() != target.size())
+    {
+        throw "'CheckData:InputError', ' retrieval_target needs one intensity per target point'";
+    }
+
+    if (retrieval_iterations <= 0)
+    {
+        throw "'CheckData:InputError', ' retrieval_iterations must be positive'";
+    }
+
+    auto n_points = target.size();
+    std::vector<floatType> amplitude(n_points);
+    floatType amplitudeNorm = 0;
+    for (size_t q = 0; q < n_points; ++q)
+    {
+        amplitude[q] = sqrt(std::max<floatType>(retrieval_target[q], 0));
+        amplitudeNorm += retrieval_target[q];
+    }
+
+    amplitudeNorm = sqrt(amplitudeNorm);
+    if (amplitudeNorm == 0)
+    {
+        throw "'CheckData:InputError', ' retrieval_target is zero'";
+    }
+
+    PartialFieldCache cache(*this, target);
+    phases = cache.LensPhases();
+
+    // Gram matrix G(lens, other) = SUM(Q) conj(U_lens(Q)) U_other(Q), with a
+    // little regularization for nearly dependent lens fields
+    int lenses = cache.Lenses();
+    std::vector<complexType> gram(lenses * lenses);
+    std::vector<complexType> field;
+    for (int other = 0; other < lenses; ++other)
+    {
+        cache.LensField(other, field);
+        auto column = cache.BackPropagate(field);
+        for (int lens = 0; lens < lenses; ++lens)
+        {
+            gram[lens * lenses + other] = column[lens];
+        }
+    }
+
+    floatType trace = 0;
+    for (int lens = 0; lens < lenses; ++lens)
+    {
+        trace += std::real(gram[lens * lenses + lens]);
+    }
+
+    for (int lens = 0; lens < lenses; ++lens)
+    {
+        gram[lens * lenses + lens] += 1e-6 * trace / lenses;
+    }
+
+    CholeskyFactor(gram, lenses);
+
+    std::vector<complexType> constrained(n_points);
+    std::vector<floatType> history;
+    history.reserve(retrieval_iterations);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int iteration = 0; iteration < retrieval_iterations; ++iteration)
+    {
+        cache.SetLensPhases(phases);
+        auto const& U = cache.TotalField();
+
+        floatType fieldNorm = 0;
+        for (auto const& u : U)
+        {
+            fieldNorm += std::norm(u);
+        }
+
+        fieldNorm = sqrt(fieldNorm);
+
+        floatType error = 0;
+        for (size_t q = 0; q < n_points; ++q)
+        {
+            auto magnitude = std::abs(U[q]);
+            auto difference = magnitude / fieldNorm - amplitude[q] / amplitudeNorm;
+            error += difference * difference;
+
+            constrained[q] = (magnitude > 0) ? amplitude[q] * U[q] / magnitude : complexType(amplitude[q]);
+        }
+
+        history.push_back(sqrt(error));
+
+        auto back = cache.BackPropagate(constrained);
+        CholeskySolve(gram, lenses, back);
+        for (size_t lens = 0; lens < phases.size(); ++lens)
+        {
+            phases[lens] = std::arg(back[lens]);
+        }
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%d iterations, error %g -> %g, %g ms per iteration\n",
+        retrieval_iterations, history.front(), history.back(), 1000 * elapsed.count() / retrieval_iterations);
+
+    return history;
+}
+
+void NearField_PhaseRetrieval(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto target = n.MakeTarget();
+    std::vector<floatType> phases;
+    n.RetrievePhases(*target, phases);
+
+    WriteToCSV(outputFile, phases);
+}
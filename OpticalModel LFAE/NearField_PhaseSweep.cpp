@@ -0,0 +1,22 @@
+#include "stdafx.h"
+
+#include <vector>
+
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "PartialFieldCache.h"
+#include "WriteToCSV.h"
+
+using namespace jsonHelper;
+
+void NearField_PhaseSweep(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto target = n.MakeTarget();
+    PartialFieldCache cache(n, *target);
+    auto I = cache.EvaluatePhases(n.phase_configurations);
+
+    WriteToCSV(outputFile, I);
+}
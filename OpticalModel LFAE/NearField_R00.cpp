@@ -7,16 +7,22 @@
 #include <complex>
 #include <fstream>
 #include <math.h>
-#include <thread>
 #include <vector>
 
 #include "ArraySetup.h"
+#include "Apodization.h"
 #include "Array2D.h"
 #include "ClosePackCenters.h"
 #include "ConfigHelpers.h"
+#include "LensSampling.h"
+#include "NearField.h"
 #include "NearField_R00.h"
+#include "Parallel.h"
+#include "SpaceFillingCurve.h"
+#include "TargetGeometry.h"
 #include "VectorMath.h"
 #include "WriteToCSV.h"
+#include "Zernike.h"
 
 using std::vector;
 using namespace VectorMath;
@@ -28,381 +34,579 @@ void RandomizeCenters(pointVector &v, const floatType &rand_polarization);
 
 void WriteVector(std::string const& name, pointVector &oa_center);
 
-template <typename floatType>
-Array2D<Point3<floatType>> GetTarget(int side, floatType extent, floatType distance);
-
 Point3<floatType>
 mean(pointVector const& v);
 
-const auto i = complexType(0, 1);
-const auto _2 = complexType(2);
-const auto _1 = complexType(1);
 const Vector3<floatType> z(0, 0, 1);
 
-class NearField
+Array2D<floatType> NearField::R00()
+{
+    auto target = MakeTarget();
+    return R00(*target);
+}
+
+Array2D<floatType> NearField::R00(TargetGeometry<floatType> const& targetGeometry)
 {
-public:
-    //% Declared System Configuration Details
-    //%= ==================================== =
-    //%   Dlens = diameter of each lens, meters
-    floatType Dlens = 0.5;
+    //% Near Field Optical Model for an array of laser fiber amplifier emitters
+    //% An array of N emitters is modeled by prescribing the(nominal) location
+    //% of each emitter, and its associate lens diameter and optical axis
+    //% pointing vector.
+    //% The near field intensity is calculated on some target surface, e.g., on
+    //% a perpendicular(normal) plane located at some distance in front of the
+    //% array.
+    //% The intensity is calculated by summing complex phases from contributions
+    //% of discretized points on each lens; the intensity is calculated at
+    //% selected locations on the target surface.
+    //
+    //% Initial Version 03 / 12 / 2017 --gbh
+    //% Modified 03 / 28 / 2017 --added aperture to U(x, y) --gbh
+    //% Modified 04 / 13 / 2017 --changed lens size determination --gbh
+    //
+
+    SetupArray();
 
-    //%   lens_pitch = lens pitch, meters; center - to - center distance from the
-    //%   center lens to a lens in the first 'shell'
-    floatType lens_pitch = 0.5;
+    //% Define the Target Surface
+    //%= ======================== =
+    //% setup a 'footprint' in the x - y plane around the center of the array,
+    //% where the footprint points will be projected directly upward onto the
+    //% target surface.
+    //% e.g., the footprint can be a square grid, with equal spacing in x and y,
+    //% centered around the origin, which is also the nominal center of the
+    //% emitter array
+    // The footprint is supplied by the TargetGeometry - see MakeTarget; its
+    // points are made from their index as they are needed
 
     //
-    //%   n_lens_shells = number of lens 'shells' on one radius of the array, not
-    //%   including the center lens
-    int n_lens_shells = 3;
+    //% calculate locations on the target surface above the footprint
+    //% e.g., target surface is a horizontal plane 100 km high; store the
+    //% plane using an appropriate plane equation over the meshgrid
+    //Z = 0 * X + 0 * Y + target_surf_dist;
+    //
+    //% Calculate Beam Intensity in the Target Plane
+    //%= ============================================
+    //% Seek to determine the beam intensity at each point in the target surface
+    //% by calculating the sum of complex phases for each discretized lens point.
+    //% The complex phase is determined by the distance from the lens point
+    //% to its projection onto the lens reference plane.
+    //
+    //% U(x, y, z) = SUM(i_pt from 1 to n_total_points)
+    //% {
+    //    [((e ^ (i k a sin(theta(i_pt))) - 1)] / (i k a sin(theta(i_pt)))] *
+    //    %[(e ^ (i(k t(i_pt) + phi(i_pt)))]
+    //}
+    //% theta(i_pt) = angle between the optical axis and a vector from(x, y, z) to
+    //%               the discretized lens point
+    //% t(i_pt) = projection distance from the discretized lens point to the
+    //%           array reference plane along the vector from the lens point to
+    //%           the point on the target surface
+    //% phi(i_pt) = a phase perturbation term; will include fixed misalignment
+    //%             perturbations, transient misalignmet perturbations, and
+    //%             controlled changes to emitter phase for beam pointing and
+    //%             shaping goals
+    //% a = discretization radius, determined by the lens discretization setup
+    //% k = 2 * pi / lambda;
+    //
+    //% The intensity is I(x, y, z) = [magnitude(U(x, y, z))] ^ 2
+    //
+    //% need to sum contributions from each emitter at each location on the
+    //% target surface
+    //% initialize complex phase storage array to zeros
+    //U = zeros(npts, npts);
+    //U = complex(U, 0);
+
+    // U can probably be eliminated 
+    // by calculating U for every point on the target, the value of I can be calculated at that point
+    // this eliminates the storage requirement for U entirely - since it isn't graphed, there's no later use of it
+    Array2D<floatType> I(targetGeometry.rows(), targetGeometry.cols());
+
+    //% loop through points on the target surface
 
+    //% define Qi to be the current point on the target surface
+    //Qi = [X(i_x, i_y) Y(i_x, i_y) Z(i_x, i_y)];
+
+    // with fov_margin set, lenses are culled a tile of points at a time
+    fov_kept_fraction = 1;
+    if (fov_margin > 0)
+    {
+        ShineOnTiles(targetGeometry, I);
+        return I;
+    }
+
+    // each thread takes a contiguous run of target_order, and the results
+    // land in their row major places
+    std::vector<size_t> order;
+    if (target_order != "native")
+    {
+        order = GridCurveOrder(targetGeometry.rows(), targetGeometry.cols(), target_order);
+    }
+
+    ParallelFor(targetGeometry.size(), m_threadCount, [&](size_t begin, size_t end) {
+        for (auto i = begin; i < end; ++i)
+        {
+            auto q = order.empty() ? i : order[i];
+            *(I.begin() + q) = ShineOnTargetPoint(targetGeometry.PointAt(q));
+        }
+    });
+
+    //% theta(i) = angle between the optical axis and a vector
+    //% from the point Qi = (x, y, z) on the target surface to the
+    //% discretized lens point Pi
+    //% oa_vector was normalized on definition
+    //dot_QiPi_oa = dotProductV1V2(oa_vector(i_lens, :), QiPi);
+    //theta_i = acos(dot_QiPi_oa);
+    //
+    //% t = projection distance from the discretized lens point Pi to
+    //% the array reference plane along the vector from the lens
+    //% point P) to the point Qi on the target surface
+    //t_i = point_plane_oblique_distance(Pi, refplane_N, ...
+    //    refplane_anchor, QiPi);
+    //
+    //% U(i_pt) = { [((e ^ (i k a sin(theta(i_pt))) - 1)] /
+    //    % (i k a sin(theta(i_pt))) }*
+    //    %[(e ^ (i(k t(i_pt) + phi(i_pt)))]
+    //        U(i_x, i_y) = U(i_x, i_y) + ...
+    //        ((exp(1i*k * 2 * discr_rad*sin(theta_i)) - 1) / ...
+    //        (1i*k * 2 * discr_rad*sin(theta_i)))* ...
+    //            (exp(1i*(k*t_i + phi(i_pt))));
+    //end
+    //end
+    //% intensity is I(i_pt) = [magnitude(U(i_pt))] ^ 2
+    //I(i_x, i_y) = (abs(U(i_x, i_y))) ^ 2;
+    //end
+    //end
     //
-    //%   lambda = nominal emitter wavelength, meters
-    floatType lambda = static_cast<floatType>(1.064e-6);
-
-    //%   Demitter = fiber tip diameter of all emitters, meters
-    floatType Demitter = static_cast<floatType>(12.5e-6);
-
-    //%   NAemitter = Numerical Aperture of all fiber tips
-    floatType NAemitter = static_cast<floatType>(0.22);
-
-    //%   FOV = optical(angular) field of view for all lenses, radians
-    //%         From Mission Parameters, e.g., produce a 1 m beam at 100 km
-    floatType FOV = static_cast<floatType>(1e-5);
-
-    //%   n_medium = index of refraction of the medium(1 in vacuum of space)
-    floatType n_medium = 1;
-
-    //%   target_surf_dist = distance of the target surface from the nominal
-    //%   emitter array center, meters
-    floatType target_surf_dist = 1000;
-
-    //%   ndiscr = number of 'shells' on one radius of a lens element, not
-    //%   including the center point
-    int n_discr_shells = 5;
-
-    int npts = 100;
-    floatType gmax = 3;
-
-    int m_threadCount = 0;
-
-    pointType refplane_anchor;
-    int n_lenses;
-    int n_lens_pts;
-    floatType discr_rad;
-    vector<floatType> phi;
-    vector<pointType> oa_vector;
-
-    //dataType gmin = -3;
-
-public:
-    Array2D<floatType> R00()
-    {
-        //% Near Field Optical Model for an array of laser fiber amplifier emitters
-        //% An array of N emitters is modeled by prescribing the(nominal) location
-        //% of each emitter, and its associate lens diameter and optical axis
-        //% pointing vector.
-        //% The near field intensity is calculated on some target surface, e.g., on
-        //% a perpendicular(normal) plane located at some distance in front of the
-        //% array.
-        //% The intensity is calculated by summing complex phases from contributions
-        //% of discretized points on each lens; the intensity is calculated at
-        //% selected locations on the target surface.
-        //
-        //% Initial Version 03 / 12 / 2017 --gbh
-        //% Modified 03 / 28 / 2017 --added aperture to U(x, y) --gbh
-        //% Modified 04 / 13 / 2017 --changed lens size determination --gbh
-        //
-
-        floatType Rlens = Dlens / 2;
-
-        //
-        //%   lens_pitch must be greater than or equal to Dlens
-        assert(lens_pitch >= Dlens);
-
-        floatType array_radius = n_lens_shells*lens_pitch;
-        k = static_cast<floatType>(2 * M_PI / lambda);
-
-        //
-        //
-        //
-        //
-        //% Declared Optical Properties
-        //%= ========================== =
-        //%   i_lens = lens index, 1, 2, ... n_lenses
-        //%   oa_center(i_lens) = nominal optical center positions(x, y, z), meters
-        //%                       for each lens in the array
-        //%   n_lenses = total number of lenses in the array, calculated from the
-        //%                       number of desired emitter shells and the lens
-        //%                       pitch previously declared
-
-        auto oa_center = ArraySetup<floatType>(n_lens_shells, lens_pitch);
+    //% calculate intensity attenuation compared to the highest intensity on the
+    //% target surface
+    //dbI = 10 * log10(I / max(I(:)));
+    //
+    //% plot 3D oblique view of intensity attenuation
+    //min_dbI = min(dbI(:));
+
+    return I;
+}
+
+void NearField::SetupArray()
+{
+    floatType Rlens = Dlens / 2;
+
+    //
+    //%   lens_pitch must be greater than or equal to Dlens
+    assert(lens_pitch >= Dlens || !lens_geometry_file.empty());
+
+    floatType array_radius = n_lens_shells*lens_pitch;
+    k = static_cast<floatType>(2 * M_PI / lambda);
+
+    //
+    //
+    //
+    //
+    //% Declared Optical Properties
+    //%= ========================== =
+    //%   i_lens = lens index, 1, 2, ... n_lenses
+    //%   oa_center(i_lens) = nominal optical center positions(x, y, z), meters
+    //%                       for each lens in the array
+    //%   n_lenses = total number of lenses in the array, calculated from the
+    //%                       number of desired emitter shells and the lens
+    //%                       pitch previously declared
+
+    //   (or every lens as given in lens_geometry_file)
+    if (!lens_geometry_file.empty())
+    {
+        LoadLensGeometry();
+    }
+    else
+    {
+        oa_center = ArraySetup<floatType>(n_lens_shells, lens_pitch);
         //WriteVector("oa_center", oa_center);
 
         n_lenses = static_cast<int>(oa_center.size());
 
         //%   oa_vector(i_lens) = nominal optical axis pointing vectors, meters
         oa_vector = std::vector<pointType>(n_lenses, z);
-        //WriteVector("oa_vector", oa_vector);
-
-        // Since the vector was initialized as normalized, this is unnecessary
-        //NormalizeVectors(oa_vector);
-
-        //
-        //% Build a nominal lens discretization grid
-        //%= ========================================
-        //
-        //%   the grid is centered at the origin, using close - packed circular
-        //%   discrete elements within the lens aperture
-        //[discr_ctr, discr_rad, n_lens_pts] = ...
-        auto discr_ctr = ClosePackCenters<floatType>(n_discr_shells, Rlens, discr_rad);
-        //WriteVector("ClosePackCenters", discr_ctr);
-        n_lens_pts = static_cast<int>(discr_ctr.size());
-
-        //%   the total number of discretized lens elements in the entire array is
-        //%   determined from the numer of points within each lens times the number
-        //%   of lenses in the overall array
-        int n_total_points = n_lenses * n_lens_pts;
-        //
-        //%   phi(p) = phase angle for each lens discretization point, radians
-        //phi = zeros(n_total_points, 1);
-        phi = vector<floatType>(n_total_points, 1);
-        //
-        //%   use the nominal grid as a template to create the actual emitter
-        //%   aperture discretizations, by translating and rotating the nominal grid
-        //%   to each optical center and optical vector
-        auto lens_pts = Array2D<pointType>(n_lenses, n_lens_pts);
-
-        //for i_lens = 1:n_lenses
+
+        lens_scale.assign(n_lenses, 1);
+        lens_piston.clear();
+    }
+
+    //   or the configured lens_axes, one x, y, z row per lens
+    if (!lens_axes.empty())
+    {
+        if (static_cast<int>(lens_axes.size()) != n_lenses)
+        {
+            throw "'CheckData:InputError', ' lens_axes needs one axis per lens'";
+        }
+
         for (int i_lens = 0; i_lens < n_lenses; ++i_lens)
         {
-            //% give the pattern a whirl, to 'randomize' polarization ?
-            //    rand_polarization = pi*rand(1, 1);
-            floatType rand_polarization = static_cast<floatType>(M_PI * rand() / RAND_MAX);
-            //RandomizeCenters(discr_ctr, rand_polarization);
-
-            //% first, align the current aperture to the optical vector
-            //    % rotation axis is the cross product of the optical axis with the
-            //    % z - axis, since the template was built in the x - y plane
-            auto raxis = CrossProduct(oa_vector[i_lens], z);
-
-            //       % product with the z-axis will be a null vector, with norm zero;
-            //       % otherwise, the cross-product vector will have some length.
-            //       norm_raxis = normV (raxis);
-            auto norm_raxis = raxis.Norm();
-            //       if (norm_raxis > 0)
-            if (norm_raxis > 0)
-            {
-                //           % force rotation axis to length 1
-                //           raxis = raxis./normV (raxis);
-
-                //           % oa_vector was normalized at definition
-                //           dot_oa_z = dotProductV1V2 (oa_vector(i_lens,:), [0 0 1]);
-                //           rtheta = acos (dot_oa_z);
-
-                //           % loop through the discretized lens points to rotate and
-                //           % translate into the lens position
-                //           for i_pt = 1:n_lens_pts
-                //               % rotation center is the origin
-                //               lens_pts(n_lens_pts*(i_lens - 1) + i_pt,:) = ...
-                //                RotatePoint3d ([0 0 0], rtheta, raxis, discr_ctr(i_pt,:));
-                //               % translate the rotated point out to the lens position
-                //               lens_pts(n_lens_pts*(i_lens - 1) + i_pt,:) = ...
-                //                       lens_pts(n_lens_pts*(i_lens - 1) + i_pt,:) + ...
-                //                       oa_center(i_lens,:);
-                //           end
-            }
-            else
+            auto const& axis = lens_axes[i_lens];
+            if (axis.size() != 3)
             {
-                auto lensPtIter = lens_pts[i_lens].begin();
-                for (auto const& centerPt : discr_ctr)
-                {
-                    *lensPtIter = centerPt + oa_center[i_lens];
-                    ++lensPtIter;
-                }
+                throw "'CheckData:InputError', ' each of lens_axes is x, y, z'";
             }
+
+            oa_vector[i_lens] = pointType(axis[0], axis[1], axis[2]);
+            oa_vector[i_lens].Normalize();
         }
-        //% Define the Target Surface
-        //%= ======================== =
-        //% setup a 'footprint' in the x - y plane around the center of the array,
-        //% where the footprint points will be projected directly upward onto the
-        //% target surface.
-        //% e.g., the footprint can be a square grid, with equal spacing in x and y,
-        //% centered around the origin, which is also the nominal center of the
-        //% emitter array
-        //npts = 100;
-        //gmin = -3;
-        //gmax = -gmin;
-        //deltag = (gmax - gmin) / (npts - 1);
-        //
-        //% calculate footprint grid locations
-        //gv = (gmin:deltag:gmax)';
-        //[X, Y] = meshgrid(gv, gv);
-        auto target = GetTarget<floatType>(npts, gmax, target_surf_dist);
-
-        //
-        //% calculate locations on the target surface above the footprint
-        //% e.g., target surface is a horizontal plane 100 km high; store the
-        //% plane using an appropriate plane equation over the meshgrid
-        //Z = 0 * X + 0 * Y + target_surf_dist;
-        //
-        //% Calculate Beam Intensity in the Target Plane
-        //%= ============================================
-        //% Seek to determine the beam intensity at each point in the target surface
-        //% by calculating the sum of complex phases for each discretized lens point.
-        //% The complex phase is determined by the distance from the lens point
-        //% to its projection onto the lens reference plane.
-        //
-        //% U(x, y, z) = SUM(i_pt from 1 to n_total_points)
-        //% {
-        //    [((e ^ (i k a sin(theta(i_pt))) - 1)] / (i k a sin(theta(i_pt)))] *
-        //    %[(e ^ (i(k t(i_pt) + phi(i_pt)))]
-        //}
-        //% theta(i_pt) = angle between the optical axis and a vector from(x, y, z) to
-        //%               the discretized lens point
-        //% t(i_pt) = projection distance from the discretized lens point to the
-        //%           array reference plane along the vector from the lens point to
-        //%           the point on the target surface
-        //% phi(i_pt) = a phase perturbation term; will include fixed misalignment
-        //%             perturbations, transient misalignmet perturbations, and
-        //%             controlled changes to emitter phase for beam pointing and
-        //%             shaping goals
-        //% a = discretization radius, determined by the lens discretization setup
-        //% k = 2 * pi / lambda;
-        //
-        //% The intensity is I(x, y, z) = [magnitude(U(x, y, z))] ^ 2
-        //
-        //% need to sum contributions from each emitter at each location on the
-        //% target surface
-        //% initialize complex phase storage array to zeros
-        //U = zeros(npts, npts);
-        //U = complex(U, 0);
-
-        // U can probably be eliminated 
-        // by calculating U for every point on the target, the value of I can be calculated at that point
-        // this eliminates the storage requirement for U entirely - since it isn't graphed, there's no later use of it
-        Array2D<floatType> I(npts, npts);
-
-        //% loop through points on the target surface
-
-        //% define Qi to be the current point on the target surface
-        //Qi = [X(i_x, i_y) Y(i_x, i_y) Z(i_x, i_y)];
-
-        //% the reference plane for the array is anchored at a point that is the
-        //% average location of optical centers in the array. **Calculate inside
-        //% the loop to allow for changing optical center positions**
-        // # note, not done because oa centers are not currently changing
-        //refplane_anchor = mean(oa_center, 1);
-        refplane_anchor = mean(oa_center);
-
-        // If the m_threadCount is zero, use the hardware_concurrency value
-        int maxThreads = m_threadCount ? m_threadCount : static_cast<int>(std::thread::hardware_concurrency());
-
-        if (maxThreads <= 1)
+    }
+    //WriteVector("oa_vector", oa_vector);
+
+    // Since the vector was initialized as normalized, this is unnecessary
+    //NormalizeVectors(oa_vector);
+
+    //
+    //% Build a nominal lens discretization grid
+    //%= ========================================
+    //
+    //%   the grid is centered at the origin, using close - packed circular
+    //%   discrete elements within the lens aperture, or equal-area
+    //%   low-discrepancy samples when lens_sampling selects them
+    //[discr_ctr, discr_rad, n_lens_pts] = ...
+    discr_ctr = DiscretizeLens(Rlens);
+    //WriteVector("ClosePackCenters", discr_ctr);
+
+    //%   lens_weight(i_pt) = amplitude of the emitter illumination at each
+    //%   point, with the points below apodization_threshold dropped
+    ApodizeLens(Rlens);
+
+    //%   stored along lens_point_order, so runs of the template are compact
+    //%   patches of the aperture
+    auto lens_order = PointCurveOrder(discr_ctr, lens_point_order);
+    pointVector ordered_ctr(discr_ctr.size());
+    std::vector<floatType> ordered_weight(discr_ctr.size());
+    for (size_t i = 0; i < lens_order.size(); ++i)
+    {
+        ordered_ctr[i] = discr_ctr[lens_order[i]];
+        ordered_weight[i] = lens_weight[lens_order[i]];
+    }
+    discr_ctr = std::move(ordered_ctr);
+    lens_weight = std::move(ordered_weight);
+    n_lens_pts = static_cast<int>(discr_ctr.size());
+
+    //%   the total number of discretized lens elements in the entire array is
+    //%   determined from the numer of points within each lens times the number
+    //%   of lenses in the overall array
+    //n_total_points = n_lenses * n_lens_pts;
+    //
+    //%   phi(p) = phase angle for each lens discretization point, radians
+    //phi = zeros(n_total_points, 1);
+    //   phi(i_lens, i_pt) = 1 + the Zernike aberration of the lens, from the
+    //   basis table on the template; each row starts on a cache line
+    size_t n_terms = 1;
+    for (auto const& coefficients : zernike_coefficients)
+    {
+        n_terms = std::max(n_terms, coefficients.size());
+    }
+
+    zernike_basis = ZernikeBasis(discr_ctr, Rlens, static_cast<int>(n_terms));
+    phi = Array2D<floatType>(n_lenses, n_lens_pts, true);
+    for (int i_lens = 0; i_lens < n_lenses; ++i_lens)
+    {
+        UpdateLensPhase(i_lens);
+    }
+    //
+    //%   use the nominal grid as a template to create the actual emitter
+    //%   aperture discretizations, by translating and rotating the nominal grid
+    //%   to each optical center and optical vector
+    //   (only the transform of each lens is kept - see LensPoint)
+    lens_transform = std::vector<LensTransform>(n_lenses);
+
+    //for i_lens = 1:n_lenses
+    for (int i_lens = 0; i_lens < n_lenses; ++i_lens)
+    {
+        PlaceLens(i_lens);
+    }
+
+    //% the reference plane for the array is anchored at a point that is the
+    //% average location of optical centers in the array. **Calculate inside
+    //% the loop to allow for changing optical center positions**
+    // # note, not done because oa centers are not currently changing
+    //refplane_anchor = mean(oa_center, 1);
+    refplane_anchor = mean(oa_center);
+}
+
+// lens_transform(lens) from oa_center and oa_vector
+void NearField::PlaceLens(int i_lens)
+{
+    //% first, align the current aperture to the optical vector
+    //    % rotation axis is the cross product of the optical axis with the
+    //    % z - axis, since the template was built in the x - y plane
+    auto raxis = CrossProduct(oa_vector[i_lens], z);
+
+    //       % product with the z-axis will be a null vector, with norm zero;
+    //       % otherwise, the cross-product vector will have some length.
+    //       norm_raxis = normV (raxis);
+    auto norm_raxis = raxis.Norm();
+    //       if (norm_raxis > 0)
+    if (norm_raxis > 0)
+    {
+        //           % force rotation axis to length 1
+        //           raxis = raxis./normV (raxis);
+        raxis = raxis / norm_raxis;
+
+        //           % oa_vector was normalized at definition
+        //           dot_oa_z = dotProductV1V2 (oa_vector(i_lens,:), [0 0 1]);
+        //           rtheta = acos (dot_oa_z);
+        auto rtheta = acos(std::min(std::max(DotProduct(oa_vector[i_lens], z), -1.0), 1.0));
+
+        //           % loop through the discretized lens points to rotate and
+        //           % translate into the lens position
+        //           for i_pt = 1:n_lens_pts
+        //               % rotation center is the origin
+        //               lens_pts(n_lens_pts*(i_lens - 1) + i_pt,:) = ...
+        //                RotatePoint3d ([0 0 0], rtheta, raxis, discr_ctr(i_pt,:));
+        //               % translate the rotated point out to the lens position
+        //               lens_pts(n_lens_pts*(i_lens - 1) + i_pt,:) = ...
+        //                       lens_pts(n_lens_pts*(i_lens - 1) + i_pt,:) + ...
+        //                       oa_center(i_lens,:);
+        //           end
+        // raxis = oa x z, so the right handed rotation that carries z
+        // onto oa_vector is by -rtheta.  The matrix is built once for
+        // the lens and applied to the template points as they are used.
+        lens_transform[i_lens].rotation = RotationMatrix(-rtheta, raxis);
+    }
+    else
+    {
+        lens_transform[i_lens].rotation = Matrix3x3<floatType>(1, 0, 0, 0, 1, 0, 0, 0, 1);
+    }
+
+    // a lens of another diameter is the template scaled about its center
+    auto scale = lens_scale[i_lens];
+    if (scale != 1)
+    {
+        for (auto& row : lens_transform[i_lens].rotation.value)
         {
-            for (int i = 0; i < static_cast<int>(target.size()); ++i)
+            for (auto& element : row)
             {
-                *(I.begin() + i) = ShineOnTargetPoint(target, i, lens_pts);
-            };
+                element *= scale;
+            }
         }
-        else
+    }
+
+    lens_transform[i_lens].discr_rad = scale * discr_rad;
+    lens_transform[i_lens].center = oa_center[i_lens];
+}
+
+void NearField::MoveLens(int lens, pointType const& center, pointType const& axis)
+{
+    assert(lens >= 0 && lens < n_lenses);
+
+    oa_center[lens] = center;
+    oa_vector[lens] = axis;
+    oa_vector[lens].Normalize();
+
+    PlaceLens(lens);
+}
+
+void NearField::UpdateRefplaneAnchor()
+{
+    refplane_anchor = mean(oa_center);
+}
+
+floatType NearField::ShineOnTargetPoint(pointType const& Qi) const
+{
+    auto refplane_N = ReferencePlaneNormal(Qi);
+
+    complexType U;
+
+    //% the sum of complex phases U(xpi, ypi, zpi) at every point in the target
+    //% surface will be over the number of lenses in the array, and then over
+    //% the number of discretization points in each lens
+    for (int lens = 0; lens < n_lenses; ++lens)
+    {
+        AddLensField(Qi, refplane_N, lens, U);
+    }
+
+    return std::norm(U);
+}
+
+void NearField::LensFieldsAtPoint(pointType const& Qi, complexType* U) const
+{
+    auto refplane_N = ReferencePlaneNormal(Qi);
+
+    for (int lens = 0; lens < n_lenses; ++lens)
+    {
+        U[lens] = 0;
+        AddLensField(Qi, refplane_N, lens, U[lens]);
+    }
+}
+
+pointType NearField::ReferencePlaneNormal(pointType const& Qi) const
+{
+    auto refplane_N = Qi - refplane_anchor;
+    if (ApproximatelyZero(refplane_N.Norm()))
+    {
+        throw "'CheckData:InputError', ' refplane_N is degenerate'";
+    }
+
+    return refplane_N.Normalize();
+}
+
+void NearField::AddLensField(pointType const& Qi, pointType const& refplane_N, int lens, complexType& U) const
+{
+    auto oa_lens = oa_vector[lens];
+    auto const& transform = lens_transform[lens];
+    auto phi_lens = phi[lens];
+    auto weight = lens_weight.data();
+    for (int i_pt = 0; i_pt < n_lens_pts; ++i_pt)
+    {
+        auto Pi = transform.Apply(discr_ctr[i_pt]);
+        //% establish a vector QiPi from the point Qi = (x, y, z) on the
+        //% target surface to the discretized lens point Pi
+        auto QiPi = (Pi - Qi).Normalize();
+        auto dot_QiPi_oa = DotProduct(oa_lens, QiPi);
+        auto theta_i = acos(dot_QiPi_oa);
+        auto t_i = PointPlaneObliqueDistance(Pi, refplane_N, refplane_anchor, QiPi);
+        auto sintheta_i = sin(theta_i);
+        U += LensPointField(transform.discr_rad, sintheta_i, t_i, weight[i_pt], phi_lens[i_pt]);
+    }
+}
+
+std::unique_ptr<TargetGeometry<floatType>> NearField::MakeTarget() const
+{
+    if (target_geometry == "grid")
+    {
+        return std::make_unique<GridTarget<floatType>>(npts, gmax, target_surf_dist);
+    }
+
+    if (target_geometry == "line")
+    {
+        return std::make_unique<LineCutTarget<floatType>>(npts, gmax, target_angle, target_surf_dist);
+    }
+
+    if (target_geometry == "polar")
+    {
+        return std::make_unique<PolarTarget<floatType>>(npts, n_theta, gmax, target_surf_dist, polar_symmetry);
+    }
+
+    if (target_geometry == "hex")
+    {
+        return std::make_unique<HexTarget<floatType>>(npts, gmax, target_surf_dist);
+    }
+
+    throw "'CheckData:InputError', ' unknown target_geometry'";
+}
+
+void NearField::SetZernikeCoefficients(int lens, std::vector<floatType> const& coefficients)
+{
+    assert(lens >= 0 && lens < n_lenses);
+
+    if (static_cast<int>(coefficients.size()) > zernike_basis.cols())
+    {
+        throw "'CheckData:InputError', ' more Zernike terms than were set up'";
+    }
+
+    if (zernike_coefficients.size() <= static_cast<size_t>(lens))
+    {
+        zernike_coefficients.resize(lens + 1);
+    }
+
+    zernike_coefficients[lens] = coefficients;
+    UpdateLensPhase(lens);
+}
+
+// phi(lens, :) = 1 + piston(lens) + zernike_basis * coefficients(lens)
+void NearField::UpdateLensPhase(int lens)
+{
+    auto row = phi[lens];
+    auto piston = (static_cast<size_t>(lens) < lens_piston.size()) ? lens_piston[lens] : 0;
+    std::fill(row.begin(), row.end(), 1 + piston);
+
+    if (static_cast<size_t>(lens) < zernike_coefficients.size())
+    {
+        auto const& coefficients = zernike_coefficients[lens];
+        for (int i_pt = 0; i_pt < n_lens_pts; ++i_pt)
         {
-            int qi = 0;
-            int stride = static_cast<int>((target.size() + maxThreads - 1) / maxThreads);
-            vector<std::thread> threads;
-            for (int proc = 0; proc < maxThreads; ++proc)
+            for (size_t term = 0; term < coefficients.size(); ++term)
             {
-                threads.push_back(std::thread([&, qi, stride]() {
-                    for (int i = 0; i < stride; ++i)
-                    {
-                        *(I.begin() + qi + i) = ShineOnTargetPoint(target, qi + i, lens_pts);
-                    }
-                }));
-                qi += stride;
-                stride = std::min<int>(stride, static_cast<int>(target.size() - qi));
+                row[i_pt] += zernike_basis(i_pt, static_cast<int>(term)) * coefficients[term];
             }
+        }
+    }
+}
 
-            for (auto& thread : threads)
-            {
-                thread.join();
-            }
+// lens_weight for discr_ctr, dropping the points below apodization_threshold
+// Every term of U has magnitude at most its weight, so dropping points of
+// total weight d out of s changes |U| by at most d / s of the coherent sum
+// n_lenses * s, and I by at most (2 d / s + (d / s)^2) of the coherent peak.
+void NearField::ApodizeLens(floatType Rlens)
+{
+    if (emitter_apodization == "uniform")
+    {
+        lens_weight.assign(discr_ctr.size(), 1);
+    }
+    else if (emitter_apodization == "gaussian")
+    {
+        auto w = GaussianBeamRadius(Demitter, NAemitter, lambda, Rlens);
+
+        lens_weight.resize(discr_ctr.size());
+        for (size_t i_pt = 0; i_pt < discr_ctr.size(); ++i_pt)
+        {
+            lens_weight[i_pt] = GaussianAmplitude(discr_ctr[i_pt].Norm(), w);
         }
+    }
+    else
+    {
+        throw "'CheckData:InputError', ' unknown emitter_apodization'";
+    }
 
-        //% theta(i) = angle between the optical axis and a vector
-        //% from the point Qi = (x, y, z) on the target surface to the
-        //% discretized lens point Pi
-        //% oa_vector was normalized on definition
-        //dot_QiPi_oa = dotProductV1V2(oa_vector(i_lens, :), QiPi);
-        //theta_i = acos(dot_QiPi_oa);
-        //
-        //% t = projection distance from the discretized lens point Pi to
-        //% the array reference plane along the vector from the lens
-        //% point P) to the point Qi on the target surface
-        //t_i = point_plane_oblique_distance(Pi, refplane_N, ...
-        //    refplane_anchor, QiPi);
-        //
-        //% U(i_pt) = { [((e ^ (i k a sin(theta(i_pt))) - 1)] /
-        //    % (i k a sin(theta(i_pt))) }*
-        //    %[(e ^ (i(k t(i_pt) + phi(i_pt)))]
-        //        U(i_x, i_y) = U(i_x, i_y) + ...
-        //        ((exp(1i*k * 2 * discr_rad*sin(theta_i)) - 1) / ...
-        //        (1i*k * 2 * discr_rad*sin(theta_i)))* ...
-        //            (exp(1i*(k*t_i + phi(i_pt))));
-        //end
-        //end
-        //% intensity is I(i_pt) = [magnitude(U(i_pt))] ^ 2
-        //I(i_x, i_y) = (abs(U(i_x, i_y))) ^ 2;
-        //end
-        //end
-        //
-        //% calculate intensity attenuation compared to the highest intensity on the
-        //% target surface
-        //dbI = 10 * log10(I / max(I(:)));
-        //
-        //% plot 3D oblique view of intensity attenuation
-        //min_dbI = min(dbI(:));
+    if (apodization_threshold < 0 || apodization_threshold >= 1)
+    {
+        throw "'CheckData:InputError', ' apodization_threshold must be in [0, 1)'";
+    }
 
-        return I;
+    apodization_error = 0;
+    if (apodization_threshold == 0)
+    {
+        return;
     }
 
-    floatType ShineOnTargetPoint(Array2D<pointType>& target, int offset, Array2D<pointType> &lens_pts) const
+    auto peak = *std::max_element(lens_weight.begin(), lens_weight.end());
+    floatType total = 0;
+    floatType dropped = 0;
+    size_t kept = 0;
+    for (size_t i_pt = 0; i_pt < discr_ctr.size(); ++i_pt)
     {
-        auto Qi = *(target.begin() + offset);
-        auto refplane_N = Qi - refplane_anchor;
-        if (ApproximatelyZero(refplane_N.Norm()))
+        total += lens_weight[i_pt];
+        if (lens_weight[i_pt] < apodization_threshold * peak)
         {
-            throw "'CheckData:InputError', ' refplane_N is degenerate'";
+            dropped += lens_weight[i_pt];
+            continue;
         }
-        refplane_N.Normalize();
 
-        complexType U;
+        discr_ctr[kept] = discr_ctr[i_pt];
+        lens_weight[kept] = lens_weight[i_pt];
+        ++kept;
+    }
 
-        for (int lens = 0; lens < n_lenses; ++lens)
-        {
-            auto oa_lens = oa_vector[lens];
-            //% the sum of complex phases U(xpi, ypi, zpi) at every point in the target
-            //% surface will be over the number of lenses in the array, and then over
-            //% the number of discretization points in each lens
-            for (int i_pt = 0; i_pt < n_lens_pts; ++i_pt)
-            {
-                auto Pi = lens_pts[lens][i_pt];
-                //% establish a vector QiPi from the point Qi = (x, y, z) on the
-                //% target surface to the discretized lens point Pi
-                auto QiPi = (Pi - Qi).Normalize();
-                auto dot_QiPi_oa = DotProduct(oa_lens, QiPi);
-                auto theta_i = acos(dot_QiPi_oa);
-                auto t_i = PointPlaneObliqueDistance(Pi, refplane_N, refplane_anchor, QiPi);
-                auto sintheta_i = sin(theta_i);
-                U += ((exp(i * k * _2 * discr_rad * sintheta_i) - _1) / (i * k * _2 * discr_rad * sintheta_i))* (exp(i * (k*t_i + phi[i_pt])));
-            }
-        }
+    discr_ctr.resize(kept);
+    lens_weight.resize(kept);
+    apodization_error = dropped / total;
+}
 
-        return std::norm(U);
+pointVector NearField::DiscretizeLens(floatType Rlens)
+{
+    if (lens_sampling == "closepack")
+    {
+        return ClosePackCenters<floatType>(n_discr_shells, Rlens, discr_rad);
     }
 
-private:
-    floatType k;
-};
+    if (n_lens_sample_pts <= 0)
+    {
+        throw "'CheckData:InputError', ' n_lens_sample_pts must be positive'";
+    }
+
+    if (lens_sampling == "fibonacci")
+    {
+        return FibonacciSpiralCenters<floatType>(n_lens_sample_pts, Rlens, discr_rad);
+    }
+
+    if (lens_sampling == "sobol")
+    {
+        return SobolDiskCenters<floatType>(n_lens_sample_pts, Rlens, discr_rad);
+    }
+
+    throw "'CheckData:InputError', ' unknown lens_sampling'";
+}
 
 void WriteVector(std::string const& name, pointVector &oa_center)
 {
@@ -433,34 +637,6 @@ void NormalizeVectors(std::vector<Point3<T>> &v)
     }
 }
 
-template <typename floatType>
-Array2D<Point3<floatType>> GetTarget(int side, floatType extent, floatType distance)
-{
-    assert(side > 0);
-    assert(extent > 0);
-
-    Array2D<Point3<floatType>> data(side, side);
-
-    auto min = -extent;
-    auto max = extent;
-    auto range = max - min;
-    auto increment = range / (side - 1);
-
-    auto iter = data.begin();
-    for (int y = 0; y < side; ++y)
-    {
-        floatType yVal = y * increment + min;
-        for (int x = 0; x < side; ++x, ++iter)
-        {
-            iter->X() = x * increment + min;
-            iter->Y() = yVal;
-            iter->Z() = distance;
-        }
-    }
-
-    return data;
-}
-
 Point3<floatType>
 mean(pointVector const& v)
 {
@@ -482,14 +658,71 @@ void to_json(json& j, const NearField& p) {
         { "Dlens", p.Dlens },
         { "lens_pitch", p.lens_pitch },
         { "n_lens_shells", p.n_lens_shells },
+        { "lens_geometry_file", p.lens_geometry_file },
+        { "lens_list_file", p.lens_list_file },
         { "lambda", p.lambda },
         { "Demitter", p.Demitter },
         { "NAemitter", p.NAemitter },
+        { "emitter_apodization", p.emitter_apodization },
+        { "apodization_threshold", p.apodization_threshold },
         { "FOV", p.FOV },
+        { "fov_margin", p.fov_margin },
         { "target_surf_dist", p.target_surf_dist },
         { "n_discr_shells", p.n_discr_shells },
+        { "lens_sampling", p.lens_sampling },
+        { "n_lens_sample_pts", p.n_lens_sample_pts },
+        { "lens_point_order", p.lens_point_order },
         { "npts", p.npts },
         { "gmax", p.gmax },
+        { "target_geometry", p.target_geometry },
+        { "target_angle", p.target_angle },
+        { "n_theta", p.n_theta },
+        { "polar_symmetry", p.polar_symmetry },
+        { "target_order", p.target_order },
+        { "target_file", p.target_file },
+        { "target_file_format", p.target_file_format },
+        { "target_chunk_size", p.target_chunk_size },
+        { "volume_z_min", p.volume_z_min },
+        { "volume_z_max", p.volume_z_max },
+        { "n_volume_slices", p.n_volume_slices },
+        { "regions", p.regions },
+        { "tile_cache_dir", p.tile_cache_dir },
+        { "tile_size", p.tile_size },
+        { "partial_field_budget_mb", p.partial_field_budget_mb },
+        { "partial_field_spill_file", p.partial_field_spill_file },
+        { "phase_configurations", p.phase_configurations },
+        { "lens_phases", p.lens_phases },
+        { "metric", p.metric },
+        { "bucket_radius", p.bucket_radius },
+        { "metric_weights", p.metric_weights },
+        { "spgd_iterations", p.spgd_iterations },
+        { "spgd_gain", p.spgd_gain },
+        { "spgd_perturbation", p.spgd_perturbation },
+        { "spgd_detector_npts", p.spgd_detector_npts },
+        { "spgd_seed", p.spgd_seed },
+        { "retrieval_target", p.retrieval_target },
+        { "retrieval_iterations", p.retrieval_iterations },
+        { "failure_pairs", p.failure_pairs },
+        { "zernike_coefficients", p.zernike_coefficients },
+        { "lens_axes", p.lens_axes },
+        { "n_screens", p.n_screens },
+        { "screen_r0", p.screen_r0 },
+        { "screen_outer_scale", p.screen_outer_scale },
+        { "screen_inner_scale", p.screen_inner_scale },
+        { "screen_points", p.screen_points },
+        { "screen_subharmonics", p.screen_subharmonics },
+        { "screen_seed", p.screen_seed },
+        { "mc_trials", p.mc_trials },
+        { "mc_seed", p.mc_seed },
+        { "mc_center_sigma", p.mc_center_sigma },
+        { "mc_tilt_sigma", p.mc_tilt_sigma },
+        { "mc_phase_sigma", p.mc_phase_sigma },
+        { "transient_steps", p.transient_steps },
+        { "transient_dt", p.transient_dt },
+        { "transient_seed", p.transient_seed },
+        { "jitter_sigma", p.jitter_sigma },
+        { "axis_drift_rate", p.axis_drift_rate },
+        { "phase_noise_sigma", p.phase_noise_sigma },
         { "m_threadCount", p.m_threadCount },
     };
 }
@@ -499,14 +732,71 @@ void from_json(const json& j, NearField& p)
     p.Dlens = GetValueOrDefault(j, "Dlens", p.Dlens);
     p.lens_pitch = GetValueOrDefault(j, "lens_pitch", p.lens_pitch);
     p.n_lens_shells = GetValueOrDefault(j, "n_lens_shells", p.n_lens_shells);
+    p.lens_geometry_file = GetValueOrDefault(j, "lens_geometry_file", p.lens_geometry_file);
+    p.lens_list_file = GetValueOrDefault(j, "lens_list_file", p.lens_list_file);
     p.lambda = GetValueOrDefault(j, "lambda", p.lambda);
     p.Demitter = GetValueOrDefault(j, "Demitter", p.Demitter);
     p.NAemitter = GetValueOrDefault(j, "NAemitter", p.NAemitter);
+    p.emitter_apodization = GetValueOrDefault(j, "emitter_apodization", p.emitter_apodization);
+    p.apodization_threshold = GetValueOrDefault(j, "apodization_threshold", p.apodization_threshold);
     p.FOV = GetValueOrDefault(j, "FOV", p.FOV);
+    p.fov_margin = GetValueOrDefault(j, "fov_margin", p.fov_margin);
     p.target_surf_dist = GetValueOrDefault(j, "target_surf_dist", p.target_surf_dist);
     p.n_discr_shells = GetValueOrDefault(j, "n_discr_shells", p.n_discr_shells);
+    p.lens_sampling = GetValueOrDefault(j, "lens_sampling", p.lens_sampling);
+    p.n_lens_sample_pts = GetValueOrDefault(j, "n_lens_sample_pts", p.n_lens_sample_pts);
+    p.lens_point_order = GetValueOrDefault(j, "lens_point_order", p.lens_point_order);
     p.npts = GetValueOrDefault(j, "npts", p.npts);
     p.gmax = GetValueOrDefault(j, "gmax", p.gmax);
+    p.target_geometry = GetValueOrDefault(j, "target_geometry", p.target_geometry);
+    p.target_angle = GetValueOrDefault(j, "target_angle", p.target_angle);
+    p.n_theta = GetValueOrDefault(j, "n_theta", p.n_theta);
+    p.polar_symmetry = GetValueOrDefault(j, "polar_symmetry", p.polar_symmetry);
+    p.target_order = GetValueOrDefault(j, "target_order", p.target_order);
+    p.target_file = GetValueOrDefault(j, "target_file", p.target_file);
+    p.target_file_format = GetValueOrDefault(j, "target_file_format", p.target_file_format);
+    p.target_chunk_size = GetValueOrDefault(j, "target_chunk_size", p.target_chunk_size);
+    p.volume_z_min = GetValueOrDefault(j, "volume_z_min", p.volume_z_min);
+    p.volume_z_max = GetValueOrDefault(j, "volume_z_max", p.volume_z_max);
+    p.n_volume_slices = GetValueOrDefault(j, "n_volume_slices", p.n_volume_slices);
+    p.regions = GetValueOrDefault(j, "regions", p.regions);
+    p.tile_cache_dir = GetValueOrDefault(j, "tile_cache_dir", p.tile_cache_dir);
+    p.tile_size = GetValueOrDefault(j, "tile_size", p.tile_size);
+    p.partial_field_budget_mb = GetValueOrDefault(j, "partial_field_budget_mb", p.partial_field_budget_mb);
+    p.partial_field_spill_file = GetValueOrDefault(j, "partial_field_spill_file", p.partial_field_spill_file);
+    p.phase_configurations = GetValueOrDefault(j, "phase_configurations", p.phase_configurations);
+    p.lens_phases = GetValueOrDefault(j, "lens_phases", p.lens_phases);
+    p.metric = GetValueOrDefault(j, "metric", p.metric);
+    p.bucket_radius = GetValueOrDefault(j, "bucket_radius", p.bucket_radius);
+    p.metric_weights = GetValueOrDefault(j, "metric_weights", p.metric_weights);
+    p.spgd_iterations = GetValueOrDefault(j, "spgd_iterations", p.spgd_iterations);
+    p.spgd_gain = GetValueOrDefault(j, "spgd_gain", p.spgd_gain);
+    p.spgd_perturbation = GetValueOrDefault(j, "spgd_perturbation", p.spgd_perturbation);
+    p.spgd_detector_npts = GetValueOrDefault(j, "spgd_detector_npts", p.spgd_detector_npts);
+    p.spgd_seed = GetValueOrDefault(j, "spgd_seed", p.spgd_seed);
+    p.retrieval_target = GetValueOrDefault(j, "retrieval_target", p.retrieval_target);
+    p.retrieval_iterations = GetValueOrDefault(j, "retrieval_iterations", p.retrieval_iterations);
+    p.failure_pairs = GetValueOrDefault(j, "failure_pairs", p.failure_pairs);
+    p.zernike_coefficients = GetValueOrDefault(j, "zernike_coefficients", p.zernike_coefficients);
+    p.lens_axes = GetValueOrDefault(j, "lens_axes", p.lens_axes);
+    p.n_screens = GetValueOrDefault(j, "n_screens", p.n_screens);
+    p.screen_r0 = GetValueOrDefault(j, "screen_r0", p.screen_r0);
+    p.screen_outer_scale = GetValueOrDefault(j, "screen_outer_scale", p.screen_outer_scale);
+    p.screen_inner_scale = GetValueOrDefault(j, "screen_inner_scale", p.screen_inner_scale);
+    p.screen_points = GetValueOrDefault(j, "screen_points", p.screen_points);
+    p.screen_subharmonics = GetValueOrDefault(j, "screen_subharmonics", p.screen_subharmonics);
+    p.screen_seed = GetValueOrDefault(j, "screen_seed", p.screen_seed);
+    p.mc_trials = GetValueOrDefault(j, "mc_trials", p.mc_trials);
+    p.mc_seed = GetValueOrDefault(j, "mc_seed", p.mc_seed);
+    p.mc_center_sigma = GetValueOrDefault(j, "mc_center_sigma", p.mc_center_sigma);
+    p.mc_tilt_sigma = GetValueOrDefault(j, "mc_tilt_sigma", p.mc_tilt_sigma);
+    p.mc_phase_sigma = GetValueOrDefault(j, "mc_phase_sigma", p.mc_phase_sigma);
+    p.transient_steps = GetValueOrDefault(j, "transient_steps", p.transient_steps);
+    p.transient_dt = GetValueOrDefault(j, "transient_dt", p.transient_dt);
+    p.transient_seed = GetValueOrDefault(j, "transient_seed", p.transient_seed);
+    p.jitter_sigma = GetValueOrDefault(j, "jitter_sigma", p.jitter_sigma);
+    p.axis_drift_rate = GetValueOrDefault(j, "axis_drift_rate", p.axis_drift_rate);
+    p.phase_noise_sigma = GetValueOrDefault(j, "phase_noise_sigma", p.phase_noise_sigma);
     p.m_threadCount = GetValueOrDefault(j, "m_threadCount", p.m_threadCount);
 }
 
@@ -517,3 +807,14 @@ Array2D<floatType> NearField_R00(std::string const& paramFile)
 
     return n.R00();
 }
+
+void NearField_R00(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    WriteToCSV(outputFile, *target, I);
+}
\ No newline at end of file
@@ -7,4 +7,53 @@
 
 Array2D<floatType> NearField_R00(std::string const& parameters);
 
+// Evaluates the configured target geometry and writes x, y, z, I for each point
+void NearField_R00(std::string const& parameters, std::string const& outputFile);
+
+// Converts the lens_list_file CSV or JSON lens list to a binary lens geometry
+// file, outputFile, for use as lens_geometry_file
+void NearField_ImportLensGeometry(std::string const& parameters, std::string const& outputFile);
+
+// Evaluates the target_file surface and writes the intensities as binary doubles
+void NearField_TargetFile(std::string const& parameters, std::string const& outputFile);
+
+// Evaluates the target_geometry footprint at n_volume_slices distances and
+// writes the slices one after another, separated by a blank line
+void NearField_Volume(std::string const& parameters, std::string const& outputFile);
+
+// Evaluates all of the configured regions and writes them one after another,
+// separated by a blank line
+void NearField_Regions(std::string const& parameters, std::string const& outputFile);
+
+// Same as NearField_R00, reusing and filling the tile_cache_dir tile cache
+void NearField_Cached(std::string const& parameters, std::string const& outputFile);
+
+// Evaluates the target geometry under each of the phase_configurations and
+// writes the intensities one after another, separated by a blank line
+void NearField_PhaseSweep(std::string const& parameters, std::string const& outputFile);
+
+// Writes d(metric)/d(phase) for each lens at lens_phases
+void NearField_Gradient(std::string const& parameters, std::string const& outputFile);
+
+// Simulates SPGD phase control and writes the detector metric per iteration
+void NearField_Spgd(std::string const& parameters, std::string const& outputFile);
+
+// Retrieves the lens phases for retrieval_target and writes them
+void NearField_PhaseRetrieval(std::string const& parameters, std::string const& outputFile);
+
+// Writes lens, other_lens, peak, power, bucket_power for every failure case
+void NearField_FailureScan(std::string const& parameters, std::string const& outputFile);
+
+// Evaluates the target geometry under n_screens turbulence realizations and
+// writes them one after another, separated by a blank line
+void NearField_Turbulence(std::string const& parameters, std::string const& outputFile);
+
+// Runs the Monte Carlo tolerance study and writes
+// trial, peak, power, bucket_power, centroid_x, centroid_y per trial
+void NearField_MonteCarlo(std::string const& parameters, std::string const& outputFile);
+
+// Runs the transient time stepping and writes
+// step, time, peak, power, bucket_power, centroid_x, centroid_y per step
+void NearField_Transient(std::string const& parameters, std::string const& outputFile);
+
 
@@ -0,0 +1,72 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "Parallel.h"
+#include "WriteToCSV.h"
+
+using namespace jsonHelper;
+
+std::vector<std::unique_ptr<TargetGeometry<floatType>>> NearField::MakeRegionTargets() const
+{
+    if (regions.empty())
+    {
+        throw "'CheckData:InputError', ' no regions configured'";
+    }
+
+    std::vector<std::unique_ptr<TargetGeometry<floatType>>> targets;
+    for (auto const& region : regions)
+    {
+        targets.push_back(std::make_unique<GridTarget<floatType>>(
+            region.npts, region.extent, target_surf_dist, region.center_x, region.center_y));
+    }
+
+    return targets;
+}
+
+// The points of all of the targets are numbered end to end, and that one
+// index range is split across the threads, so the lens setup and the thread
+// launch are shared and small regions don't leave threads idle.
+std::vector<Array2D<floatType>> NearField::R00Regions(std::vector<std::unique_ptr<TargetGeometry<floatType>>> const& targets)
+{
+    SetupArray();
+
+    std::vector<Array2D<floatType>> I;
+
+    // firstPoint[region] is the combined index of the region's first point
+    std::vector<size_t> firstPoint(1, 0);
+    for (auto const& target : targets)
+    {
+        I.push_back(Array2D<floatType>(target->rows(), target->cols()));
+        firstPoint.push_back(firstPoint.back() + target->size());
+    }
+
+    ParallelFor(firstPoint.back(), m_threadCount, [&](size_t begin, size_t end) {
+        auto region = std::upper_bound(firstPoint.begin(), firstPoint.end(), begin) - firstPoint.begin() - 1;
+        for (auto q = begin; q < end; ++q)
+        {
+            while (q >= firstPoint[region + 1])
+            {
+                ++region;
+            }
+
+            auto offset = q - firstPoint[region];
+            *(I[region].begin() + offset) = ShineOnTargetPoint(targets[region]->PointAt(offset));
+        }
+    });
+
+    return I;
+}
+
+void NearField_Regions(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto I = n.R00Regions(n.MakeRegionTargets());
+
+    WriteToCSV(outputFile, I);
+}
@@ -0,0 +1,92 @@
+#include "stdafx.h"
+
+#define _USE_MATH_DEFINES
+
+#include <chrono>
+#include <math.h>
+#include <random>
+#include <vector>
+
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "PartialFieldCache.h"
+#include "TargetMetric.h"
+#include "WriteToCSV.h"
+
+using namespace jsonHelper;
+
+// The lens fields are only needed at the detector points, so the cache over
+// the detector grid is small enough to hold in memory, and each measurement
+// is a few hundred points x n_lenses multiply-adds.
+std::vector<floatType> NearField::SimulateSpgd(std::vector<floatType>& phases)
+{
+    if (spgd_iterations <= 0 || spgd_detector_npts <= 1)
+    {
+        throw "'CheckData:InputError', ' spgd_iterations must be positive and spgd_detector_npts greater than 1'";
+    }
+
+    GridTarget<floatType> detector(spgd_detector_npts, bucket_radius, target_surf_dist);
+    auto weights = BucketWeights<floatType>(detector, 0, 0, bucket_radius);
+
+    PartialFieldCache cache(*this, detector);
+
+    std::mt19937 generator(spgd_seed);
+    phases = cache.LensPhases();
+    if (lens_phases.empty())
+    {
+        std::uniform_real_distribution<floatType> uniform(0, 2 * M_PI);
+        for (auto& phase : phases)
+        {
+            phase = uniform(generator);
+        }
+    }
+
+    std::bernoulli_distribution coin;
+    std::vector<floatType> delta(phases.size());
+    std::vector<floatType> plus(phases.size());
+    std::vector<floatType> minus(phases.size());
+    std::vector<floatType> history;
+    history.reserve(spgd_iterations);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int iteration = 0; iteration < spgd_iterations; ++iteration)
+    {
+        for (size_t lens = 0; lens < phases.size(); ++lens)
+        {
+            delta[lens] = coin(generator) ? spgd_perturbation : -spgd_perturbation;
+            plus[lens] = phases[lens] + delta[lens];
+            minus[lens] = phases[lens] - delta[lens];
+        }
+
+        auto Jplus = cache.EvaluateMetric(weights, plus);
+        auto Jminus = cache.EvaluateMetric(weights, minus);
+        auto sum = Jplus + Jminus;
+        auto step = (sum > 0) ? spgd_gain * (Jplus - Jminus) / sum : 0;
+
+        for (size_t lens = 0; lens < phases.size(); ++lens)
+        {
+            phases[lens] += step * delta[lens];
+        }
+
+        history.push_back(cache.EvaluateMetric(weights, phases));
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%d lenses, %d detector points: %d iterations in %g s, %g iterations/s\n",
+        n_lenses, static_cast<int>(detector.size()), spgd_iterations, elapsed.count(),
+        spgd_iterations / elapsed.count());
+
+    return history;
+}
+
+void NearField_Spgd(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    std::vector<floatType> phases;
+    auto history = n.SimulateSpgd(phases);
+
+    WriteToCSV(outputFile, history);
+}
@@ -0,0 +1,78 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "Parallel.h"
+#include "TargetSource.h"
+
+using namespace jsonHelper;
+
+std::unique_ptr<TargetSource> NearField::MakeTargetSource() const
+{
+    if (target_file_format == "points")
+    {
+        return std::make_unique<TargetPointFile>(target_file);
+    }
+
+    if (target_file_format == "stl")
+    {
+        return std::make_unique<TargetStlFile>(target_file);
+    }
+
+    throw "'CheckData:InputError', ' unknown target_file_format'";
+}
+
+// Evaluate the source a chunk at a time, in parallel within each chunk, and
+// append the intensities to outputFile as doubles in source order.  Only one
+// chunk of intensities is ever held in memory.
+void NearField::ShineOnTargetSource(TargetSource const& source, std::string const& outputFile)
+{
+    if (target_chunk_size <= 0)
+    {
+        throw "'CheckData:InputError', ' target_chunk_size must be positive'";
+    }
+
+    SetupArray();
+
+    FILE* file;
+    fopen_s(&file, outputFile.c_str(), "wb");
+    if (!file)
+    {
+        throw "File not opened";
+    }
+
+    auto chunkSize = static_cast<size_t>(target_chunk_size);
+    std::vector<floatType> I(std::min(chunkSize, source.size()));
+
+    for (size_t chunkBegin = 0; chunkBegin < source.size(); chunkBegin += chunkSize)
+    {
+        auto count = std::min(chunkSize, source.size() - chunkBegin);
+
+        ParallelFor(count, m_threadCount, [&](size_t begin, size_t end) {
+            for (auto i = begin; i < end; ++i)
+            {
+                I[i] = ShineOnTargetPoint(source.Point(chunkBegin + i));
+            }
+        });
+
+        if (fwrite(I.data(), sizeof(floatType), count, file) != count)
+        {
+            fclose(file);
+            throw "File not written";
+        }
+    }
+
+    fclose(file);
+}
+
+void NearField_TargetFile(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto source = n.MakeTargetSource();
+    n.ShineOnTargetSource(*source, outputFile);
+}
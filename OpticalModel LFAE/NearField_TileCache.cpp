@@ -0,0 +1,334 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string.h>
+#include <vector>
+
+#include "LensGeometry.h"
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "Parallel.h"
+#include "WriteToCSV.h"
+
+using namespace jsonHelper;
+
+// Target points on a cached grid of spacing h sit on the lattice
+// (ix * h, iy * h, target_surf_dist).  The lattice is cut into square tiles of
+// tile_size points, and each computed tile is stored in its own file, named by
+// the physics hash, the spacing, the tile size and the tile coordinates.
+// Any window whose points fall on the lattice - overlapping and panned
+// windows, repeated sweep points - reuses the stored tiles.  A grid with
+// twice the spacing shares every other point, so when a tile is missing the
+// points it has in common with a stored coarser tile are taken from it too,
+// which makes nested npts = 2^k + 1 refinement reuse the coarse work.
+namespace
+{
+    struct Tile
+    {
+        int64_t tx;
+        int64_t ty;
+        std::vector<floatType> values; // tile_size x tile_size, NaN until known
+        bool fromCache;
+    };
+
+    uint64_t Fnv1a(void const* data, size_t size, uint64_t hash = 14695981039346656037ull)
+    {
+        auto bytes = static_cast<unsigned char const*>(data);
+        for (size_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+
+        return hash;
+    }
+
+    int64_t FloorDiv(int64_t a, int64_t b)
+    {
+        return (a >= 0) ? a / b : -((-a + b - 1) / b);
+    }
+
+    // the lattice point nearest coordinate; snapped is set when coordinate
+    // is not itself on the lattice
+    int64_t LatticeIndex(floatType coordinate, floatType h, bool& snapped)
+    {
+        auto index = coordinate / h;
+        auto nearest = floor(index + 0.5);
+        if (fabs(index - nearest) > 1e-6)
+        {
+            snapped = true;
+        }
+
+        return static_cast<int64_t>(nearest);
+    }
+
+    // the tiles covering a side x side window whose corner is the lattice
+    // point (ix0, iy0) of spacing h
+    struct TileWindow
+    {
+        floatType h;
+        int64_t ix0;
+        int64_t iy0;
+        int64_t tx0;
+        int64_t ty0;
+        int64_t tilesX;
+        int64_t tilesY;
+    };
+
+    TileWindow WindowTiles(int side, floatType extent, floatType centerX, floatType centerY, int tileSize, bool& snapped)
+    {
+        assert(side > 1);
+        assert(extent > 0);
+
+        TileWindow window;
+        window.h = 2 * extent / (side - 1);
+        window.ix0 = LatticeIndex(centerX - extent, window.h, snapped);
+        window.iy0 = LatticeIndex(centerY - extent, window.h, snapped);
+        window.tx0 = FloorDiv(window.ix0, tileSize);
+        window.ty0 = FloorDiv(window.iy0, tileSize);
+        window.tilesX = FloorDiv(window.ix0 + side - 1, tileSize) - window.tx0 + 1;
+        window.tilesY = FloorDiv(window.iy0 + side - 1, tileSize) - window.ty0 + 1;
+
+        return window;
+    }
+
+    std::string TileFileName(std::string const& dir, uint64_t physics, floatType h, int tileSize, int64_t tx, int64_t ty)
+    {
+        uint64_t hBits;
+        static_assert(sizeof(hBits) == sizeof(h), "spacing is keyed by its bit pattern");
+        memcpy(&hBits, &h, sizeof(h));
+
+        char name[128];
+        snprintf(name, sizeof(name), "/%016llx_%016llx_%d_%lld_%lld.tile",
+            static_cast<unsigned long long>(physics), static_cast<unsigned long long>(hBits),
+            tileSize, static_cast<long long>(tx), static_cast<long long>(ty));
+
+        return dir + name;
+    }
+
+    bool LoadTile(std::string const& filename, std::vector<floatType>& values)
+    {
+        FILE* file;
+        fopen_s(&file, filename.c_str(), "rb");
+        if (!file)
+        {
+            return false;
+        }
+
+        bool loaded = fread(values.data(), sizeof(floatType), values.size(), file) == values.size() &&
+            fgetc(file) == EOF;
+        fclose(file);
+
+        return loaded;
+    }
+
+    // Write to a temporary name and rename, so a reader never sees a
+    // partial tile
+    void SaveTile(std::string const& filename, std::vector<floatType> const& values)
+    {
+        auto temporary = filename + ".tmp";
+
+        FILE* file;
+        fopen_s(&file, temporary.c_str(), "wb");
+        if (!file)
+        {
+            throw "File not opened";
+        }
+
+        bool written = fwrite(values.data(), sizeof(floatType), values.size(), file) == values.size();
+        fclose(file);
+
+        if (!written || rename(temporary.c_str(), filename.c_str()) != 0)
+        {
+            // another run may have stored the same tile first
+            remove(temporary.c_str());
+        }
+    }
+}
+
+// Only the settings that change the field at a given target point are
+// hashed.  A new setting stays out of the hash - and tiles stay shared across
+// it - until it is added to this list.
+uint64_t NearField::PhysicsHash() const
+{
+    nlohmann::json all = *this;
+    nlohmann::json j;
+    for (auto const& name : {
+        "Dlens", "lens_pitch", "n_lens_shells",
+        "lambda", "Demitter", "NAemitter", "emitter_apodization", "apodization_threshold",
+        "target_surf_dist",
+        "n_discr_shells", "lens_sampling", "n_lens_sample_pts",
+        "zernike_coefficients", "lens_axes" })
+    {
+        j[name] = all.at(name);
+    }
+
+    // json objects are ordered by key, so the dump is canonical
+    auto canonical = j.dump();
+    auto hash = Fnv1a(canonical.data(), canonical.size());
+
+    // the lenses themselves, not the name of the file they are in
+    if (!lens_geometry_file.empty())
+    {
+        LensGeometryFile geometry(lens_geometry_file);
+        hash = Fnv1a(geometry.data(), geometry.bytes(), hash);
+    }
+
+    return hash;
+}
+
+Array2D<floatType> NearField::R00Cached(int side, floatType extent, floatType centerX, floatType centerY)
+{
+    if (tile_cache_dir.empty())
+    {
+        throw "'CheckData:InputError', ' tile_cache_dir is not set'";
+    }
+
+    if (tile_size <= 0 || (tile_size & 1))
+    {
+        throw "'CheckData:InputError', ' tile_size must be positive and even'";
+    }
+
+    bool snapped = false;
+    auto window = WindowTiles(side, extent, centerX, centerY, tile_size, snapped);
+    auto h = window.h;
+    auto ix0 = window.ix0;
+    auto iy0 = window.iy0;
+    if (snapped)
+    {
+        printf("Window moved onto the tile lattice, corner at (%g, %g)\n", ix0 * h, iy0 * h);
+    }
+    auto physics = PhysicsHash();
+
+    auto tx0 = window.tx0;
+    auto ty0 = window.ty0;
+    auto tilesX = window.tilesX;
+    auto tilesY = window.tilesY;
+    auto tilePts = static_cast<size_t>(tile_size) * tile_size;
+    auto half = tile_size / 2;
+
+    std::vector<Tile> tiles;
+    std::vector<std::pair<size_t, size_t>> missing; // tile, offset within the tile
+    int cachedTiles = 0;
+
+    for (int64_t ty = ty0; ty < ty0 + tilesY; ++ty)
+    {
+        for (int64_t tx = tx0; tx < tx0 + tilesX; ++tx)
+        {
+            Tile tile = { tx, ty, std::vector<floatType>(tilePts), true };
+            if (!LoadTile(TileFileName(tile_cache_dir, physics, h, tile_size, tx, ty), tile.values))
+            {
+                tile.fromCache = false;
+                std::fill(tile.values.begin(), tile.values.end(), std::numeric_limits<floatType>::quiet_NaN());
+
+                // even lattice points of this tile are the points of a quarter
+                // of the coarser tile (FloorDiv(tx, 2), FloorDiv(ty, 2))
+                std::vector<floatType> coarse(tilePts);
+                auto cx = FloorDiv(tx, 2);
+                auto cy = FloorDiv(ty, 2);
+                if (LoadTile(TileFileName(tile_cache_dir, physics, 2 * h, tile_size, cx, cy), coarse))
+                {
+                    auto colOffset = (tx - 2 * cx) * half;
+                    auto rowOffset = (ty - 2 * cy) * half;
+                    for (int row = 0; row < tile_size; row += 2)
+                    {
+                        for (int col = 0; col < tile_size; col += 2)
+                        {
+                            tile.values[row * tile_size + col] =
+                                coarse[(rowOffset + row / 2) * tile_size + colOffset + col / 2];
+                        }
+                    }
+                }
+
+                for (size_t offset = 0; offset < tilePts; ++offset)
+                {
+                    if (std::isnan(tile.values[offset]))
+                    {
+                        missing.push_back(std::make_pair(tiles.size(), offset));
+                    }
+                }
+            }
+            else
+            {
+                ++cachedTiles;
+            }
+
+            tiles.push_back(std::move(tile));
+        }
+    }
+
+    printf("%d of %d tiles from the cache, %d points to compute\n",
+        cachedTiles, static_cast<int>(tiles.size()), static_cast<int>(missing.size()));
+
+    if (!missing.empty())
+    {
+        SetupArray();
+
+        ParallelFor(missing.size(), m_threadCount, [&](size_t begin, size_t end) {
+            for (auto m = begin; m < end; ++m)
+            {
+                auto& tile = tiles[missing[m].first];
+                auto offset = static_cast<int64_t>(missing[m].second);
+                auto ix = tile.tx * tile_size + offset % tile_size;
+                auto iy = tile.ty * tile_size + offset / tile_size;
+
+                tile.values[offset] = ShineOnTargetPoint(pointType(ix * h, iy * h, target_surf_dist));
+            }
+        });
+
+        for (auto const& tile : tiles)
+        {
+            if (!tile.fromCache)
+            {
+                SaveTile(TileFileName(tile_cache_dir, physics, h, tile_size, tile.tx, tile.ty), tile.values);
+            }
+        }
+    }
+
+    Array2D<floatType> I(side, side);
+    for (int row = 0; row < side; ++row)
+    {
+        auto iy = iy0 + row;
+        auto ty = FloorDiv(iy, tile_size);
+        for (int col = 0; col < side; ++col)
+        {
+            auto ix = ix0 + col;
+            auto tx = FloorDiv(ix, tile_size);
+            auto const& tile = tiles[static_cast<size_t>((ty - ty0) * tilesX + (tx - tx0))];
+
+            I[row][col] = tile.values[static_cast<size_t>((iy - ty * tile_size) * tile_size + (ix - tx * tile_size))];
+        }
+    }
+
+    return I;
+}
+
+std::vector<std::string> NearField::CachedTileFiles(int side, floatType extent, floatType centerX, floatType centerY) const
+{
+    bool snapped = false;
+    auto window = WindowTiles(side, extent, centerX, centerY, tile_size, snapped);
+    auto physics = PhysicsHash();
+
+    std::vector<std::string> files;
+    for (auto ty = window.ty0; ty < window.ty0 + window.tilesY; ++ty)
+    {
+        for (auto tx = window.tx0; tx < window.tx0 + window.tilesX; ++tx)
+        {
+            files.push_back(TileFileName(tile_cache_dir, physics, window.h, tile_size, tx, ty));
+        }
+    }
+
+    return files;
+}
+
+void NearField_Cached(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto I = n.R00Cached(n.npts, n.gmax);
+
+    WriteToCSV(outputFile, I);
+}
@@ -0,0 +1,141 @@
+#include "stdafx.h"
+
+#define _USE_MATH_DEFINES
+
+#include <math.h>
+#include <vector>
+
+#include "CounterRng.h"
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "Parallel.h"
+#include "TargetMetric.h"
+#include "VectorMath.h"
+
+using namespace jsonHelper;
+using namespace VectorMath;
+
+static bool Identical(pointType const& lhs, pointType const& rhs)
+{
+    return lhs.X() == rhs.X() && lhs.Y() == rhs.Y() && lhs.Z() == rhs.Z();
+}
+
+// The lens discretization and bucket weights are built once.
+// Each step only moves the lenses whose center or axis changed (placing
+// their lens points again) and sets each row of phi to the nominal phase plus
+// that step's phase noise, then evaluates the target on threads kept for the
+// whole run; only the summary of each step is kept.  The nominal array is
+// restored at the end.
+void NearField::Transient(TargetGeometry<floatType> const& target, std::string const& outputFile)
+{
+    if (transient_steps <= 0)
+    {
+        throw "'CheckData:InputError', ' transient_steps must be positive'";
+    }
+
+    SetupArray();
+
+    auto bucket = BucketWeights<floatType>(target, 0, 0, bucket_radius);
+    auto nominal = oa_center;
+    auto nominalAxis = oa_vector;
+    auto nominalTransform = lens_transform;
+    auto nominalPhi = phi;
+    auto nominalAnchor = refplane_anchor;
+    auto restore = [&]() {
+        oa_center = nominal;
+        oa_vector = nominalAxis;
+        lens_transform = nominalTransform;
+        phi = nominalPhi;
+        refplane_anchor = nominalAnchor;
+    };
+
+    // fixed drift direction of each optical axis, in the frame of its
+    // nominal axis
+    std::vector<floatType> driftAngle(n_lenses);
+    for (int lens = 0; lens < n_lenses; ++lens)
+    {
+        driftAngle[lens] = static_cast<floatType>(2 * M_PI * Philox4x32(transient_seed, 0xffffffff, lens).Uniform());
+    }
+
+    FILE* file;
+    fopen_s(&file, outputFile.c_str(), "wt");
+    if (!file)
+    {
+        throw "File not opened";
+    }
+
+    Array2D<floatType> I(target.rows(), target.cols());
+    ThreadPool pool(m_threadCount);
+
+    try
+    {
+        for (int step = 0; step < transient_steps; ++step)
+        {
+            auto time = step * transient_dt;
+            auto tilt = tan(axis_drift_rate * time);
+
+            bool moved = false;
+            for (int lens = 0; lens < n_lenses; ++lens)
+            {
+                Philox4x32 rng(transient_seed, static_cast<uint32_t>(step), static_cast<uint32_t>(lens));
+                auto dx = jitter_sigma * rng.Normal();
+                auto dy = jitter_sigma * rng.Normal();
+                auto dz = jitter_sigma * rng.Normal();
+                auto dphase = phase_noise_sigma * rng.Normal();
+
+                auto center = nominal[lens] + pointType(dx, dy, dz);
+                auto axis = TiltAxis(nominalAxis[lens], tilt * cos(driftAngle[lens]), tilt * sin(driftAngle[lens]));
+                axis.Normalize();
+
+                // exact comparison; Vector3::operator == allows LAMBDA, far more
+                // than the jitter
+                if (!Identical(center, oa_center[lens]) || !Identical(axis, oa_vector[lens]))
+                {
+                    MoveLens(lens, center, axis);
+                    moved = true;
+                }
+
+                auto row = phi[lens];
+                auto nominalRow = nominalPhi[lens];
+                for (int pt = 0; pt < row.size(); ++pt)
+                {
+                    row[pt] = nominalRow[pt] + dphase;
+                }
+            }
+
+            if (moved)
+            {
+                UpdateRefplaneAnchor();
+            }
+
+            pool.Run(target.size(), [&](size_t begin, size_t end) {
+                for (auto q = begin; q < end; ++q)
+                {
+                    *(I.begin() + q) = ShineOnTargetPoint(target.PointAt(q));
+                }
+            });
+
+            auto s = Summarize(target, I, bucket);
+            fprintf(file, "%d, %.9g, %.17g, %.17g, %.17g, %.17g, %.17g\n",
+                step, time, s.peak, s.power, s.bucket_power, s.centroid_x, s.centroid_y);
+        }
+    }
+    catch (...)
+    {
+        fclose(file);
+        restore();
+        throw;
+    }
+
+    fclose(file);
+    restore();
+}
+
+void NearField_Transient(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto target = n.MakeTarget();
+    n.Transient(*target, outputFile);
+}
@@ -0,0 +1,152 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "Parallel.h"
+#include "PhaseScreen.h"
+#include "VectorMath.h"
+#include "WriteToCSV.h"
+
+using namespace jsonHelper;
+using namespace VectorMath;
+
+static const auto i = complexType(0, 1);
+
+// Same sum as ShineOnTargetPoint, with exp(i (k t + phi)) split into the
+// geometry term exp(i k t), shared by every realization, and a table of
+// exp(i (phi + screen)) for each realization and lens point.  Per lens point
+// and realization that leaves one complex multiply-add.
+std::vector<Array2D<floatType>> NearField::R00Screens(TargetGeometry<floatType> const& target)
+{
+    if (n_screens <= 0)
+    {
+        throw "'CheckData:InputError', ' n_screens must be positive'";
+    }
+
+    // the lens apertures span screen_points / 2 - 1 spacings either side of
+    // the screen center
+    if (screen_points < 4 || (screen_points & (screen_points - 1)) != 0)
+    {
+        throw "'CheckData:InputError', ' screen_points must be a power of 2, at least 4'";
+    }
+
+    SetupArray();
+
+    // the screen is centered on, and covers, the bounding box of the lens
+    // apertures - the lens centers, out by the radius of each lens - of any
+    // array, including one from lens_geometry_file
+    auto xmin = std::numeric_limits<floatType>::max();
+    auto ymin = xmin;
+    auto xmax = std::numeric_limits<floatType>::lowest();
+    auto ymax = xmax;
+    for (int lens = 0; lens < n_lenses; ++lens)
+    {
+        auto radius = Dlens / 2 * lens_scale[lens];
+        xmin = std::min(xmin, oa_center[lens].X() - radius);
+        xmax = std::max(xmax, oa_center[lens].X() + radius);
+        ymin = std::min(ymin, oa_center[lens].Y() - radius);
+        ymax = std::max(ymax, oa_center[lens].Y() + radius);
+    }
+
+    auto screenX = (xmin + xmax) / 2;
+    auto screenY = (ymin + ymax) / 2;
+    auto halfWidth = std::max(xmax - xmin, ymax - ymin) / 2;
+    PhaseScreen generator(screen_points, halfWidth / (screen_points / 2 - 1),
+        screen_r0, screen_outer_scale, screen_inner_scale, screen_subharmonics);
+
+    auto n_total_points = static_cast<size_t>(n_lenses) * n_lens_pts;
+
+    // every lens point placed once, for the screen samples and the sum below
+    pointVector lensPoints(n_total_points);
+    for (int lens = 0; lens < n_lenses; ++lens)
+    {
+        auto const& transform = lens_transform[lens];
+        RotateTranslatePoints(transform.rotation, transform.center, discr_ctr.data(), &lensPoints[lens * n_lens_pts], n_lens_pts);
+    }
+
+    // screen phase at each lens point, realization by realization
+    std::vector<floatType> sampled(n_screens * n_total_points);
+
+    ParallelFor(n_screens, m_threadCount, [&](size_t begin, size_t end) {
+        for (auto screen = begin; screen < end; ++screen)
+        {
+            auto realization = generator.Generate(screen_seed, static_cast<uint32_t>(screen));
+            auto samples = &sampled[screen * n_total_points];
+            for (size_t point = 0; point < n_total_points; ++point)
+            {
+                samples[point] = generator.Sample(realization, lensPoints[point].X() - screenX, lensPoints[point].Y() - screenY);
+            }
+        }
+    });
+
+    // the table is laid out lens point by lens point, the n_screens
+    // realizations of a point next to each other for the inner loop below
+    std::vector<complexType> screenPhase(n_total_points * n_screens);
+
+    ParallelFor(n_total_points, m_threadCount, [&](size_t begin, size_t end) {
+        for (auto point = begin; point < end; ++point)
+        {
+            auto lens = static_cast<int>(point / n_lens_pts);
+            auto i_pt = static_cast<int>(point % n_lens_pts);
+            for (int screen = 0; screen < n_screens; ++screen)
+            {
+                screenPhase[point * n_screens + screen] = lens_weight[i_pt] * exp(i * (phi(lens, i_pt) + sampled[screen * n_total_points + point]));
+            }
+        }
+    });
+
+    std::vector<Array2D<floatType>> I(n_screens, Array2D<floatType>(target.rows(), target.cols()));
+
+    ParallelFor(target.size(), m_threadCount, [&](size_t begin, size_t end) {
+        std::vector<complexType> U(n_screens);
+        for (auto q = begin; q < end; ++q)
+        {
+            auto Qi = target.PointAt(q);
+            auto refplane_N = ReferencePlaneNormal(Qi);
+            std::fill(U.begin(), U.end(), complexType(0));
+
+            for (int lens = 0; lens < n_lenses; ++lens)
+            {
+                auto oa_lens = oa_vector[lens];
+                auto const& transform = lens_transform[lens];
+                auto Plens = &lensPoints[lens * n_lens_pts];
+                for (int i_pt = 0; i_pt < n_lens_pts; ++i_pt)
+                {
+                    auto const& Pi = Plens[i_pt];
+                    auto QiPi = (Pi - Qi).Normalize();
+                    auto sintheta_i = sin(acos(DotProduct(oa_lens, QiPi)));
+                    auto t_i = PointPlaneObliqueDistance(Pi, refplane_N, refplane_anchor, QiPi);
+                    auto geometry = LensPointField(transform.discr_rad, sintheta_i, t_i, 1, 0);
+
+                    auto table = &screenPhase[(static_cast<size_t>(lens) * n_lens_pts + i_pt) * n_screens];
+                    for (int screen = 0; screen < n_screens; ++screen)
+                    {
+                        U[screen] += geometry * table[screen];
+                    }
+                }
+            }
+
+            for (int screen = 0; screen < n_screens; ++screen)
+            {
+                *(I[screen].begin() + q) = std::norm(U[screen]);
+            }
+        }
+    });
+
+    return I;
+}
+
+void NearField_Turbulence(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto target = n.MakeTarget();
+    auto I = n.R00Screens(*target);
+
+    WriteToCSV(outputFile, I);
+}
@@ -0,0 +1,121 @@
+#include "stdafx.h"
+
+#include <vector>
+
+#include "Integrals.h"
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "Parallel.h"
+#include "SpaceFillingCurve.h"
+#include "VectorMath.h"
+#include "WriteToCSV.h"
+
+using namespace jsonHelper;
+using namespace VectorMath;
+
+std::vector<floatType> NearField::VolumeDistances() const
+{
+    if (n_volume_slices <= 0)
+    {
+        throw "'CheckData:InputError', ' n_volume_slices must be positive'";
+    }
+
+    if (n_volume_slices == 1)
+    {
+        return std::vector<floatType>(1, volume_z_min);
+    }
+
+    std::vector<floatType> distances(n_volume_slices);
+    Integrals::for_closed_range(volume_z_min, volume_z_max, [&](auto slice, auto z, auto) {
+        distances[slice] = z;
+    }, n_volume_slices);
+
+    return distances;
+}
+
+// Same sum as ShineOnTargetPoint, but each footprint point is carried through
+// every slice at once.  The lens geometry is built once, and for each lens
+// point the in-plane part of QiPi is shared by all of the slices; only the z
+// component changes from one slice to the next.
+std::vector<Array2D<floatType>> NearField::R00Volume(TargetGeometry<floatType> const& footprint, std::vector<floatType> const& distances)
+{
+    SetupArray();
+
+    auto n_slices = distances.size();
+    std::vector<Array2D<floatType>> slices(n_slices, Array2D<floatType>(footprint.rows(), footprint.cols()));
+    std::vector<size_t> order;
+    if (target_order != "native")
+    {
+        order = GridCurveOrder(footprint.rows(), footprint.cols(), target_order);
+    }
+
+    ParallelFor(footprint.size(), m_threadCount, [&](size_t begin, size_t end) {
+        // per slice reference plane normal, and its offset from the origin
+        std::vector<pointType> refplane_N(n_slices);
+        std::vector<floatType> refplane_D(n_slices);
+        std::vector<complexType> U(n_slices);
+
+        for (auto i = begin; i < end; ++i)
+        {
+            auto q = order.empty() ? i : order[i];
+            auto footprintPt = footprint.PointAt(q);
+
+            for (size_t slice = 0; slice < n_slices; ++slice)
+            {
+                auto Qi = pointType(footprintPt.X(), footprintPt.Y(), distances[slice]);
+                refplane_N[slice] = Qi - refplane_anchor;
+                if (ApproximatelyZero(refplane_N[slice].Norm()))
+                {
+                    throw "'CheckData:InputError', ' refplane_N is degenerate'";
+                }
+                refplane_N[slice].Normalize();
+                refplane_D[slice] = DotProduct(refplane_anchor, refplane_N[slice]);
+                U[slice] = 0;
+            }
+
+            for (int lens = 0; lens < n_lenses; ++lens)
+            {
+                auto oa_lens = oa_vector[lens];
+                auto const& transform = lens_transform[lens];
+                auto phi_lens = phi[lens];
+                auto weight = lens_weight.data();
+                for (int i_pt = 0; i_pt < n_lens_pts; ++i_pt)
+                {
+                    auto Pi = transform.Apply(discr_ctr[i_pt]);
+                    auto dx = Pi.X() - footprintPt.X();
+                    auto dy = Pi.Y() - footprintPt.Y();
+                    auto rho2 = dx * dx + dy * dy;
+
+                    for (size_t slice = 0; slice < n_slices; ++slice)
+                    {
+                        auto dz = Pi.Z() - distances[slice];
+                        auto invNorm = 1 / sqrt(rho2 + dz * dz);
+                        auto QiPi = Vector3<floatType>(dx * invNorm, dy * invNorm, dz * invNorm);
+
+                        auto sintheta_i = sin(acos(DotProduct(oa_lens, QiPi)));
+                        auto t_i = (refplane_D[slice] - DotProduct(refplane_N[slice], Pi)) / DotProduct(refplane_N[slice], QiPi);
+                        U[slice] += LensPointField(transform.discr_rad, sintheta_i, t_i, weight[i_pt], phi_lens[i_pt]);
+                    }
+                }
+            }
+
+            for (size_t slice = 0; slice < n_slices; ++slice)
+            {
+                *(slices[slice].begin() + q) = std::norm(U[slice]);
+            }
+        }
+    });
+
+    return slices;
+}
+
+void NearField_Volume(std::string const& paramFile, std::string const& outputFile)
+{
+    NearField n = FromJson<NearField>(paramFile);
+    printf("Calculating based on the following:\n%s", jsonHelper::GetJson(n).c_str());
+
+    auto footprint = n.MakeTarget();
+    auto slices = n.R00Volume(*footprint, n.VolumeDistances());
+
+    WriteToCSV(outputFile, slices);
+}
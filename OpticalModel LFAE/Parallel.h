@@ -0,0 +1,141 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+// Calls fn(begin, end) over [0, count), split into one contiguous stride per
+// thread.  A threadCount of zero uses the hardware_concurrency value, and a
+// single thread runs in the calling thread.
+template<typename functionType>
+void ParallelFor(size_t count, int threadCount, functionType fn)
+{
+    int maxThreads = threadCount ? threadCount : static_cast<int>(std::thread::hardware_concurrency());
+
+    if (maxThreads <= 1 || count <= 1)
+    {
+        fn(static_cast<size_t>(0), count);
+        return;
+    }
+
+    size_t stride = (count + maxThreads - 1) / maxThreads;
+    std::vector<std::thread> threads;
+    for (size_t begin = 0; begin < count; begin += stride)
+    {
+        threads.push_back(std::thread(fn, begin, std::min(begin + stride, count)));
+    }
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+}
+
+// The strides of ParallelFor on threads that are started once and kept for
+// every Run, for loops that make a short parallel pass many times over (a
+// time step, an iteration) where starting threads each pass would show.
+// The calling thread runs the first stride itself.
+class ThreadPool
+{
+public:
+    explicit ThreadPool(int threadCount) :
+        m_threadCount(threadCount ? threadCount : static_cast<int>(std::thread::hardware_concurrency())),
+        m_count(0), m_stride(0), m_generation(0), m_pending(0), m_stop(false)
+    {
+        for (int worker = 1; worker < m_threadCount; ++worker)
+        {
+            m_threads.push_back(std::thread(&ThreadPool::Work, this, worker));
+        }
+    }
+
+    ~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_start.notify_all();
+
+        for (auto& thread : m_threads)
+        {
+            thread.join();
+        }
+    }
+
+    ThreadPool(ThreadPool const&) = delete;
+    ThreadPool& operator =(ThreadPool const&) = delete;
+
+    // Calls fn(begin, end) over [0, count) as ParallelFor(count, threadCount,
+    // fn) would, and returns once every stride is done
+    template<typename functionType>
+    void Run(size_t count, functionType fn)
+    {
+        if (m_threads.empty() || count <= 1)
+        {
+            fn(static_cast<size_t>(0), count);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_task = fn;
+            m_count = count;
+            m_stride = (count + m_threadCount - 1) / m_threadCount;
+            m_pending = static_cast<int>(m_threads.size());
+            ++m_generation;
+        }
+        m_start.notify_all();
+
+        fn(static_cast<size_t>(0), std::min(m_stride, count));
+
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this] { return m_pending == 0; });
+    }
+
+private:
+    void Work(int worker)
+    {
+        uint64_t seen = 0;
+        for (;;)
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [&] { return m_stop || m_generation != seen; });
+            if (m_stop)
+            {
+                return;
+            }
+
+            seen = m_generation;
+            auto begin = worker * m_stride;
+            auto end = std::min(begin + m_stride, m_count);
+            lock.unlock();
+
+            if (begin < end)
+            {
+                m_task(begin, end);
+            }
+
+            lock.lock();
+            if (--m_pending == 0)
+            {
+                m_done.notify_one();
+            }
+        }
+    }
+
+    int m_threadCount;
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    std::function<void(size_t, size_t)> m_task;
+    size_t m_count;
+    size_t m_stride;
+    uint64_t m_generation;
+    int m_pending;
+    bool m_stop;
+};
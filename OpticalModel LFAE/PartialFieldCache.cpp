@@ -0,0 +1,383 @@
+#include "stdafx.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "NearField.h"
+#include "Parallel.h"
+#include "PartialFieldCache.h"
+
+#ifdef _WIN32
+#define fseek64 _fseeki64
+#else
+#define fseek64 fseeko
+#endif
+
+static const auto i = complexType(0, 1);
+
+// points in one block of the configuration x lens field product; the block
+// of lens fields stays in cache while every configuration is accumulated
+static const size_t BlockPoints = 256;
+
+// target points are filled in chunks so that only a chunk of the spilled
+// lens fields is ever held in memory
+static const size_t ChunkPoints = 4096;
+
+PartialFieldCache::PartialFieldCache(NearField& nearField, TargetGeometry<floatType> const& target) :
+    m_points(target.size()),
+    m_threadCount(nearField.m_threadCount),
+    m_spillFile(nearField.partial_field_spill_file),
+    m_spill(nullptr),
+    m_intensity(target.rows(), target.cols())
+{
+    nearField.SetupArray();
+    m_lenses = nearField.n_lenses;
+
+    // checked before the field pass, which is the expensive part
+    if (!nearField.lens_phases.empty() && static_cast<int>(nearField.lens_phases.size()) != m_lenses)
+    {
+        throw "'CheckData:InputError', ' lens_phases needs one phase per lens'";
+    }
+
+    auto lensBytes = m_points * sizeof(complexType);
+    auto budget = static_cast<size_t>(std::max(nearField.partial_field_budget_mb, 0)) << 20;
+    m_inMemory = static_cast<int>(std::min<size_t>(m_lenses, budget / lensBytes));
+    m_fields.resize(m_inMemory * m_points);
+
+    if (m_inMemory < m_lenses)
+    {
+        fopen_s(&m_spill, m_spillFile.c_str(), "w+b");
+        if (!m_spill)
+        {
+            throw "File not opened";
+        }
+    }
+
+    // the destructor does not run for a throwing constructor, so the spill
+    // file is closed and removed here
+    try
+    {
+        std::vector<complexType> chunk(std::min(ChunkPoints, m_points) * m_lenses);
+
+        for (size_t chunkBegin = 0; chunkBegin < m_points; chunkBegin += ChunkPoints)
+        {
+            auto count = std::min(ChunkPoints, m_points - chunkBegin);
+
+            // chunk is laid out point by point, n_lenses fields per point
+            ParallelFor(count, m_threadCount, [&](size_t begin, size_t end) {
+                for (auto q = begin; q < end; ++q)
+                {
+                    nearField.LensFieldsAtPoint(target.PointAt(chunkBegin + q), &chunk[q * m_lenses]);
+                }
+            });
+
+            std::vector<complexType> segment(count);
+            for (int lens = 0; lens < m_lenses; ++lens)
+            {
+                auto field = (lens < m_inMemory) ? &m_fields[lens * m_points + chunkBegin] : segment.data();
+                for (size_t q = 0; q < count; ++q)
+                {
+                    field[q] = chunk[q * m_lenses + lens];
+                }
+
+                if (lens >= m_inMemory)
+                {
+                    fseek64(m_spill, static_cast<long long>((lens - m_inMemory) * lensBytes + chunkBegin * sizeof(complexType)), SEEK_SET);
+                    if (fwrite(segment.data(), sizeof(complexType), count, m_spill) != count)
+                    {
+                        throw "File not written";
+                    }
+                }
+            }
+        }
+
+        SetLensPhases(nearField.lens_phases.empty() ? std::vector<floatType>(m_lenses, 0) : nearField.lens_phases);
+    }
+    catch (...)
+    {
+        if (m_spill)
+        {
+            fclose(m_spill);
+            remove(m_spillFile.c_str());
+        }
+        throw;
+    }
+}
+
+PartialFieldCache::~PartialFieldCache()
+{
+    if (m_spill)
+    {
+        fclose(m_spill);
+        remove(m_spillFile.c_str());
+    }
+}
+
+// The field of a lens held in memory is returned in place; a spilled lens is
+// read into scratch
+complexType const* PartialFieldCache::LensFieldData(int lens, std::vector<complexType>& scratch) const
+{
+    assert(lens >= 0 && lens < m_lenses);
+
+    if (lens < m_inMemory)
+    {
+        return &m_fields[lens * m_points];
+    }
+
+    scratch.resize(m_points);
+    fseek64(m_spill, static_cast<long long>((lens - m_inMemory) * m_points * sizeof(complexType)), SEEK_SET);
+    if (fread(scratch.data(), sizeof(complexType), m_points, m_spill) != m_points)
+    {
+        throw "File not read";
+    }
+
+    return scratch.data();
+}
+
+void PartialFieldCache::LensField(int lens, std::vector<complexType>& field) const
+{
+    std::vector<complexType> scratch;
+    auto data = LensFieldData(lens, scratch);
+    field.assign(data, data + m_points);
+}
+
+Array2D<floatType> const& PartialFieldCache::SetLensPhases(std::vector<floatType> const& phases)
+{
+    assert(static_cast<int>(phases.size()) == m_lenses);
+
+    m_phases = phases;
+    m_total.assign(m_points, complexType(0));
+
+    std::vector<complexType> weight(m_lenses);
+    for (int lens = 0; lens < m_lenses; ++lens)
+    {
+        weight[lens] = exp(i * m_phases[lens]);
+    }
+
+    // the lenses held in memory in one pass over the points, a block of
+    // points at a time
+    ParallelFor(m_points, m_threadCount, [&](size_t begin, size_t end) {
+        for (auto blockBegin = begin; blockBegin < end; blockBegin += BlockPoints)
+        {
+            auto blockEnd = std::min(blockBegin + BlockPoints, end);
+            for (int lens = 0; lens < m_inMemory; ++lens)
+            {
+                auto field = &m_fields[lens * m_points];
+                for (auto q = blockBegin; q < blockEnd; ++q)
+                {
+                    m_total[q] += weight[lens] * field[q];
+                }
+            }
+        }
+    });
+
+    // then each spilled lens as it is read
+    std::vector<complexType> scratch;
+    for (int lens = m_inMemory; lens < m_lenses; ++lens)
+    {
+        auto field = LensFieldData(lens, scratch);
+
+        ParallelFor(m_points, m_threadCount, [&](size_t begin, size_t end) {
+            for (auto q = begin; q < end; ++q)
+            {
+                m_total[q] += weight[lens] * field[q];
+            }
+        });
+    }
+
+    UpdateIntensity();
+
+    return m_intensity;
+}
+
+Array2D<floatType> const& PartialFieldCache::SetLensPhase(int lens, floatType phase)
+{
+    std::vector<complexType> scratch;
+    auto field = LensFieldData(lens, scratch);
+    auto delta = exp(i * phase) - exp(i * m_phases[lens]);
+    m_phases[lens] = phase;
+
+    ParallelFor(m_points, m_threadCount, [&](size_t begin, size_t end) {
+        for (auto q = begin; q < end; ++q)
+        {
+            m_total[q] += delta * field[q];
+            *(m_intensity.begin() + q) = std::norm(m_total[q]);
+        }
+    });
+
+    return m_intensity;
+}
+
+std::vector<Array2D<floatType>> PartialFieldCache::EvaluatePhases(std::vector<std::vector<floatType>> const& configurations) const
+{
+    auto n_configs = configurations.size();
+
+    // weights[config * n_lenses + lens] = exp(i phase)
+    std::vector<complexType> weights(n_configs * m_lenses);
+    for (size_t config = 0; config < n_configs; ++config)
+    {
+        if (static_cast<int>(configurations[config].size()) != m_lenses)
+        {
+            throw "'CheckData:InputError', ' each phase configuration needs one phase per lens'";
+        }
+
+        for (int lens = 0; lens < m_lenses; ++lens)
+        {
+            weights[config * m_lenses + lens] = exp(i * configurations[config][lens]);
+        }
+    }
+
+    // U[config * m_points + q], the lenses held in memory first
+    std::vector<complexType> U(n_configs * m_points);
+
+    ParallelFor(m_points, m_threadCount, [&](size_t begin, size_t end) {
+        for (auto blockBegin = begin; blockBegin < end; blockBegin += BlockPoints)
+        {
+            auto blockEnd = std::min(blockBegin + BlockPoints, end);
+            for (size_t config = 0; config < n_configs; ++config)
+            {
+                auto Uconfig = &U[config * m_points];
+                auto Wconfig = &weights[config * m_lenses];
+                for (int lens = 0; lens < m_inMemory; ++lens)
+                {
+                    auto field = &m_fields[lens * m_points];
+                    auto weight = Wconfig[lens];
+                    for (auto q = blockBegin; q < blockEnd; ++q)
+                    {
+                        Uconfig[q] += weight * field[q];
+                    }
+                }
+            }
+        }
+    });
+
+    // then each spilled lens, read once for all of the configurations
+    std::vector<complexType> scratch;
+    for (int lens = m_inMemory; lens < m_lenses; ++lens)
+    {
+        auto field = LensFieldData(lens, scratch);
+
+        ParallelFor(m_points, m_threadCount, [&](size_t begin, size_t end) {
+            for (size_t config = 0; config < n_configs; ++config)
+            {
+                auto weight = weights[config * m_lenses + lens];
+                for (auto q = begin; q < end; ++q)
+                {
+                    U[config * m_points + q] += weight * field[q];
+                }
+            }
+        });
+    }
+
+    std::vector<Array2D<floatType>> I(n_configs, Array2D<floatType>(m_intensity.rows(), m_intensity.cols()));
+    for (size_t config = 0; config < n_configs; ++config)
+    {
+        auto iter = I[config].begin();
+        for (size_t q = 0; q < m_points; ++q, ++iter)
+        {
+            *iter = std::norm(U[config * m_points + q]);
+        }
+    }
+
+    return I;
+}
+
+floatType PartialFieldCache::MetricGradient(std::vector<floatType> const& weights, std::vector<floatType>& gradient) const
+{
+    assert(weights.size() == m_points);
+
+    floatType metric = 0;
+    std::vector<complexType> weighted(m_points);
+    for (size_t q = 0; q < m_points; ++q)
+    {
+        metric += weights[q] * std::norm(m_total[q]);
+        weighted[q] = weights[q] * m_total[q];
+    }
+
+    // SUM(Q) w(Q) conj(U(Q)) U_lens(Q) is the conjugate of the back
+    // propagated w U
+    auto back = BackPropagate(weighted);
+
+    gradient.resize(m_lenses);
+    for (int lens = 0; lens < m_lenses; ++lens)
+    {
+        gradient[lens] = -2 * std::imag(exp(i * m_phases[lens]) * std::conj(back[lens]));
+    }
+
+    return metric;
+}
+
+std::vector<complexType> PartialFieldCache::BackPropagate(std::vector<complexType> const& field) const
+{
+    assert(field.size() == m_points);
+
+    std::vector<complexType> lensField(m_lenses);
+
+    auto overlap = [&](int lens, complexType const* U_lens) {
+        complexType sum = 0;
+        for (size_t q = 0; q < m_points; ++q)
+        {
+            sum += std::conj(U_lens[q]) * field[q];
+        }
+
+        lensField[lens] = sum;
+    };
+
+    ParallelFor(m_inMemory, m_threadCount, [&](size_t begin, size_t end) {
+        for (auto lens = begin; lens < end; ++lens)
+        {
+            overlap(static_cast<int>(lens), &m_fields[lens * m_points]);
+        }
+    });
+
+    std::vector<complexType> scratch;
+    for (int lens = m_inMemory; lens < m_lenses; ++lens)
+    {
+        overlap(lens, LensFieldData(lens, scratch));
+    }
+
+    return lensField;
+}
+
+floatType PartialFieldCache::EvaluateMetric(std::vector<floatType> const& weights, std::vector<floatType> const& phases) const
+{
+    assert(weights.size() == m_points);
+    assert(static_cast<int>(phases.size()) == m_lenses);
+    if (m_inMemory < m_lenses)
+    {
+        throw "'CheckData:InputError', ' partial_field_budget_mb does not hold the lens fields'";
+    }
+
+    std::vector<complexType> weight(m_lenses);
+    for (int lens = 0; lens < m_lenses; ++lens)
+    {
+        weight[lens] = exp(i * phases[lens]);
+    }
+
+    floatType metric = 0;
+    for (size_t q = 0; q < m_points; ++q)
+    {
+        if (weights[q] != 0)
+        {
+            complexType U = 0;
+            for (int lens = 0; lens < m_lenses; ++lens)
+            {
+                U += weight[lens] * m_fields[lens * m_points + q];
+            }
+
+            metric += weights[q] * std::norm(U);
+        }
+    }
+
+    return metric;
+}
+
+void PartialFieldCache::UpdateIntensity()
+{
+    ParallelFor(m_points, m_threadCount, [&](size_t begin, size_t end) {
+        for (auto q = begin; q < end; ++q)
+        {
+            *(m_intensity.begin() + q) = std::norm(m_total[q]);
+        }
+    });
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#include "Allocators.h"
+#include "Array2D.h"
+#include "DataType.h"
+#include "TargetGeometry.h"
+
+class NearField;
+
+// Keeps U_lens(Q), the field at every target point from each lens on its own,
+// so the intensity under a new set of per-lens phases is
+//   I(Q) = | SUM(lens) exp(i phase(lens)) U_lens(Q) |^2
+// without going back to the lens points.  Setting every phase costs
+// O(points x n_lenses) and changing one lens costs O(points).
+//
+// The lens fields are stored lens by lens.  Lenses that do not fit in
+// partial_field_budget_mb are spilled to partial_field_spill_file and streamed
+// back when they are needed.
+class PartialFieldCache
+{
+public:
+    // Builds the lens discretization of nearField and fills the cache
+    // The initial phases are lens_phases, or zero when it is empty
+    PartialFieldCache(NearField& nearField, TargetGeometry<floatType> const& target);
+    ~PartialFieldCache();
+
+    PartialFieldCache(PartialFieldCache const&) = delete;
+    PartialFieldCache& operator =(PartialFieldCache const&) = delete;
+
+    // Sets every lens phase (radians) and recomputes the total field
+    Array2D<floatType> const& SetLensPhases(std::vector<floatType> const& phases);
+
+    // Changes the phase of one lens, updating the total field in place
+    // Rounding accumulates over many single lens updates; SetLensPhases
+    // starts again from the lens fields.
+    Array2D<floatType> const& SetLensPhase(int lens, floatType phase);
+
+    Array2D<floatType> const& Intensity() const { return m_intensity; }
+    std::vector<floatType> const& LensPhases() const { return m_phases; }
+    std::vector<complexType> const& TotalField() const { return m_total; }
+
+    int Lenses() const { return m_lenses; }
+    size_t Points() const { return m_points; }
+
+    // Intensity for each row of configurations, a phase per lens, without
+    // changing the cached phases.  The configurations are evaluated together
+    // as the product of the exp(i phase) matrix with the lens field matrix.
+    std::vector<Array2D<floatType>> EvaluatePhases(std::vector<std::vector<floatType>> const& configurations) const;
+
+    // Metric M = SUM(Q) w(Q) I(Q) at the current phases, and dM/dphase for
+    // every lens.  With U = SUM(lens) exp(i phase) U_lens,
+    //   dI(Q)/dphase(lens) = -2 Im(conj(U(Q)) exp(i phase) U_lens(Q))
+    // so the whole gradient is one pass over the lens fields against the
+    // adjoint field w(Q) conj(U(Q)), the cost of one SetLensPhases.
+    floatType MetricGradient(std::vector<floatType> const& weights, std::vector<floatType>& gradient) const;
+
+    // Adjoint of the lens to target propagation: SUM(Q) conj(U_lens(Q)) field(Q)
+    // for every lens
+    std::vector<complexType> BackPropagate(std::vector<complexType> const& field) const;
+
+    // Metric SUM(Q) w(Q) I(Q) under phases, without changing the cached
+    // phases; only the points with a nonzero weight are visited, on the
+    // calling thread, for control loops that evaluate a few detector points
+    // many times.  Every lens field has to be held in memory.
+    floatType EvaluateMetric(std::vector<floatType> const& weights, std::vector<floatType> const& phases) const;
+
+    // Copies U_lens(Q) for every target point into field
+    void LensField(int lens, std::vector<complexType>& field) const;
+
+private:
+    complexType const* LensFieldData(int lens, std::vector<complexType>& scratch) const;
+    void UpdateIntensity();
+
+    int m_lenses;
+    size_t m_points;
+    int m_threadCount;
+
+    // lenses [0, m_inMemory) are held in m_fields, in whole pages as it can
+    // run to partial_field_budget_mb, the rest are in m_spill
+    int m_inMemory;
+    std::vector<complexType, PageAllocator<complexType>> m_fields;
+    std::string m_spillFile;
+    FILE* m_spill;
+
+    std::vector<floatType> m_phases;
+    std::vector<complexType> m_total;
+    Array2D<floatType> m_intensity;
+};
@@ -0,0 +1,198 @@
+#include "stdafx.h"
+
+#define _USE_MATH_DEFINES
+
+#include <algorithm>
+#include <math.h>
+#include <vector>
+
+#include "CounterRng.h"
+#include "PhaseScreen.h"
+
+namespace
+{
+    // In place radix 2 transform, sum x(k) exp(+i 2 pi j k / n), unnormalized
+    void InverseFft(complexType* x, int n, int stride)
+    {
+        for (int j = 1, bit = 0; j < n; ++j)
+        {
+            int mask = n >> 1;
+            for (; bit & mask; mask >>= 1)
+            {
+                bit ^= mask;
+            }
+            bit ^= mask;
+
+            if (j < bit)
+            {
+                std::swap(x[j * stride], x[bit * stride]);
+            }
+        }
+
+        for (int length = 2; length <= n; length <<= 1)
+        {
+            auto angle = 2 * M_PI / length;
+            complexType wLength(cos(angle), sin(angle));
+            for (int start = 0; start < n; start += length)
+            {
+                complexType w(1);
+                for (int j = 0; j < length / 2; ++j)
+                {
+                    auto u = x[(start + j) * stride];
+                    auto v = x[(start + j + length / 2) * stride] * w;
+                    x[(start + j) * stride] = u + v;
+                    x[(start + j + length / 2) * stride] = u - v;
+                    w *= wLength;
+                }
+            }
+        }
+    }
+
+    // FFT grid frequency of index j, in cycles per sample
+    int SignedIndex(int j, int n)
+    {
+        return (j < n / 2) ? j : j - n;
+    }
+}
+
+PhaseScreen::PhaseScreen(int n, floatType dx, floatType r0, floatType L0, floatType l0, int subharmonics) :
+    m_n(n), m_dx(dx), m_r0(r0), m_L0(L0), m_l0(l0), m_subharmonics(subharmonics)
+{
+    if (n < 2 || (n & (n - 1)) != 0)
+    {
+        throw "'CheckData:InputError', ' phase screen size must be a power of 2'";
+    }
+
+    if (dx <= 0 || r0 <= 0)
+    {
+        throw "'CheckData:InputError', ' phase screen spacing and r0 must be positive'";
+    }
+}
+
+floatType PhaseScreen::PhasePSD(floatType fx, floatType fy) const
+{
+    auto f2 = fx * fx + fy * fy;
+    auto f02 = (m_L0 > 0) ? 1 / (m_L0 * m_L0) : 0;
+    auto psd = 0.023 * pow(m_r0, -5.0 / 3) / pow(f2 + f02, 11.0 / 6);
+
+    if (m_l0 > 0)
+    {
+        auto fm = 5.92 / (2 * M_PI * m_l0);
+        psd *= exp(-f2 / (fm * fm));
+    }
+
+    return static_cast<floatType>(psd);
+}
+
+Array2D<floatType> PhaseScreen::Generate(uint64_t seed, uint32_t realization) const
+{
+    Philox4x32 rng(seed, realization);
+
+    // high frequencies: complex gaussian amplitudes on the FFT grid
+    auto df = 1 / (m_n * m_dx);
+    std::vector<complexType> cn(m_n * m_n);
+    for (int row = 0; row < m_n; ++row)
+    {
+        for (int col = 0; col < m_n; ++col)
+        {
+            auto fx = SignedIndex(col, m_n) * df;
+            auto fy = SignedIndex(row, m_n) * df;
+            auto amplitude = (row == 0 && col == 0) ? 0 : sqrt(PhasePSD(fx, fy)) * df;
+
+            auto re = rng.Normal();
+            auto im = rng.Normal();
+            cn[row * m_n + col] = complexType(re, im) * amplitude;
+        }
+    }
+
+    for (int row = 0; row < m_n; ++row)
+    {
+        InverseFft(&cn[row * m_n], m_n, 1);
+    }
+
+    for (int col = 0; col < m_n; ++col)
+    {
+        InverseFft(&cn[col], m_n, m_n);
+    }
+
+    // the grid is x = (col - n / 2) dx, so the screen is shifted by half its
+    // width; that only moves the (periodic) screen, and the low frequencies
+    // are added on the same grid
+    Array2D<floatType> screen(m_n, m_n);
+    for (int row = 0; row < m_n; ++row)
+    {
+        for (int col = 0; col < m_n; ++col)
+        {
+            screen[row][col] = std::real(cn[row * m_n + col]);
+        }
+    }
+
+    // low frequencies: 3 x 3 subharmonic grids at df / 3^p
+    if (m_subharmonics > 0)
+    {
+        std::vector<floatType> low(m_n * m_n, 0);
+        auto D = m_n * m_dx;
+        for (int p = 1; p <= m_subharmonics; ++p)
+        {
+            auto dfp = 1 / (pow(3.0, p) * D);
+            for (int sy = -1; sy <= 1; ++sy)
+            {
+                for (int sx = -1; sx <= 1; ++sx)
+                {
+                    auto re = rng.Normal();
+                    auto im = rng.Normal();
+                    if (sx == 0 && sy == 0)
+                    {
+                        continue;
+                    }
+
+                    auto fx = sx * dfp;
+                    auto fy = sy * dfp;
+                    auto c = complexType(re, im) * (sqrt(PhasePSD(fx, fy)) * dfp);
+
+                    for (int row = 0; row < m_n; ++row)
+                    {
+                        auto y = (row - m_n / 2) * m_dx;
+                        for (int col = 0; col < m_n; ++col)
+                        {
+                            auto x = (col - m_n / 2) * m_dx;
+                            auto angle = 2 * M_PI * (fx * x + fy * y);
+                            low[row * m_n + col] += std::real(c * complexType(cos(angle), sin(angle)));
+                        }
+                    }
+                }
+            }
+        }
+
+        floatType mean = 0;
+        for (auto value : low)
+        {
+            mean += value;
+        }
+        mean /= low.size();
+
+        for (int row = 0; row < m_n; ++row)
+        {
+            for (int col = 0; col < m_n; ++col)
+            {
+                screen[row][col] += low[row * m_n + col] - mean;
+            }
+        }
+    }
+
+    return screen;
+}
+
+floatType PhaseScreen::Sample(Array2D<floatType> const& screen, floatType x, floatType y) const
+{
+    auto u = std::min(std::max(x / m_dx + m_n / 2, static_cast<floatType>(0)), static_cast<floatType>(m_n - 1));
+    auto v = std::min(std::max(y / m_dx + m_n / 2, static_cast<floatType>(0)), static_cast<floatType>(m_n - 1));
+
+    auto col = std::min(static_cast<int>(u), m_n - 2);
+    auto row = std::min(static_cast<int>(v), m_n - 2);
+    auto fu = u - col;
+    auto fv = v - row;
+
+    return (1 - fv) * ((1 - fu) * screen(row, col) + fu * screen(row, col + 1)) +
+        fv * ((1 - fu) * screen(row + 1, col) + fu * screen(row + 1, col + 1));
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "Array2D.h"
+#include "DataType.h"
+
+// Kolmogorov / von Karman turbulence phase screens by FFT synthesis, with
+// subharmonics added for the low spatial frequencies the FFT grid misses
+// (Lane, Glindemann and Dainty 1992; Johansson and Gavel 1994).
+// The phase power spectral density is
+//   0.023 r0^(-5/3) exp(-(f / fm)^2) / (f^2 + 1 / L0^2)^(11/6)
+// with fm = 5.92 / (2 pi l0); L0 <= 0 is the Kolmogorov limit and l0 <= 0
+// drops the inner scale.
+//
+// A realization depends only on (seed, realization), through Philox4x32, so
+// screens can be made in parallel and in any order.
+class PhaseScreen
+{
+public:
+    // n x n screen (n a power of 2) of spacing dx, meters, centered on the
+    // origin of the x - y plane
+    PhaseScreen(int n, floatType dx, floatType r0, floatType L0, floatType l0, int subharmonics);
+
+    // phase, radians
+    Array2D<floatType> Generate(uint64_t seed, uint32_t realization) const;
+
+    // bilinear interpolation of screen at (x, y), clamped to the screen edge
+    floatType Sample(Array2D<floatType> const& screen, floatType x, floatType y) const;
+
+private:
+    floatType PhasePSD(floatType fx, floatType fy) const;
+
+    int m_n;
+    floatType m_dx;
+    floatType m_r0;
+    floatType m_L0;
+    floatType m_l0;
+    int m_subharmonics;
+};
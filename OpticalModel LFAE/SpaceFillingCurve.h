@@ -0,0 +1,152 @@
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <numeric>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Vector3.h"
+
+// Orderings of points in the plane along a space filling curve.  Points that
+// are near each other along the curve are near each other in the plane, so a
+// contiguous run of the order - one thread's stride, a tile, a partial sum -
+// covers a compact patch rather than a strip.
+//   "native"  - the order the points were built in
+//   "morton"  - Z order, the bits of x and y interleaved
+//   "hilbert" - Hilbert curve order; consecutive cells are always neighbours
+
+// x in the even bits and y in the odd bits
+inline uint64_t MortonKey(uint32_t x, uint32_t y)
+{
+    auto spread = [](uint64_t v) {
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        v = (v | (v << 1)) & 0x5555555555555555ull;
+        return v;
+    };
+
+    return spread(x) | (spread(y) << 1);
+}
+
+// distance of cell (x, y) along the Hilbert curve through a 2^bits square
+inline uint64_t HilbertKey(int bits, uint32_t x, uint32_t y)
+{
+    assert(bits >= 1 && bits <= 32);
+
+    uint64_t n = uint64_t(1) << bits;
+    uint64_t hx = x;
+    uint64_t hy = y;
+    uint64_t d = 0;
+    for (uint64_t s = n / 2; s > 0; s /= 2)
+    {
+        uint64_t rx = (hx & s) ? 1 : 0;
+        uint64_t ry = (hy & s) ? 1 : 0;
+        d += s * s * ((3 * rx) ^ ry);
+
+        // turn the quadrant so its piece of the curve joins the next one
+        if (ry == 0)
+        {
+            if (rx == 1)
+            {
+                hx = n - 1 - hx;
+                hy = n - 1 - hy;
+            }
+
+            std::swap(hx, hy);
+        }
+    }
+
+    return d;
+}
+
+// Indices 0 .. count - 1 sorted along the curve, where cell(i, x, y) gives
+// the cell of item i on a 2^bits square; ties keep their original order
+template<typename cellFunction>
+std::vector<size_t> CurveOrder(size_t count, int bits, std::string const& curve, cellFunction cell)
+{
+    std::vector<size_t> order(count);
+    std::iota(order.begin(), order.end(), static_cast<size_t>(0));
+    if (curve == "native")
+    {
+        return order;
+    }
+
+    bool morton = curve == "morton";
+    if (!morton && curve != "hilbert")
+    {
+        throw "'CheckData:InputError', ' unknown curve order'";
+    }
+
+    std::vector<std::pair<uint64_t, size_t>> keys(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        uint32_t x, y;
+        cell(i, x, y);
+
+        keys[i].first = morton ? MortonKey(x, y) : HilbertKey(bits, x, y);
+        keys[i].second = i;
+    }
+
+    std::stable_sort(keys.begin(), keys.end(), [](auto const& a, auto const& b) {
+        return a.first < b.first;
+    });
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        order[i] = keys[i].second;
+    }
+
+    return order;
+}
+
+// row major indices of a rows x cols array, in curve order
+inline std::vector<size_t> GridCurveOrder(int rows, int cols, std::string const& curve)
+{
+    assert(rows > 0 && cols > 0);
+
+    int bits = 1;
+    while ((1 << bits) < std::max(rows, cols))
+    {
+        ++bits;
+    }
+
+    return CurveOrder(static_cast<size_t>(rows) * cols, bits, curve, [&](size_t i, uint32_t& x, uint32_t& y) {
+        x = static_cast<uint32_t>(i % cols);
+        y = static_cast<uint32_t>(i / cols);
+    });
+}
+
+// indices of scattered points, in curve order of their x - y positions
+// quantized to a 2^16 square over their bounding box
+template<typename T>
+std::vector<size_t> PointCurveOrder(std::vector<Point3<T>> const& points, std::string const& curve)
+{
+    static const int bits = 16;
+
+    T xmin = 0, xmax = 0, ymin = 0, ymax = 0;
+    if (!points.empty())
+    {
+        xmin = xmax = points[0].X();
+        ymin = ymax = points[0].Y();
+    }
+
+    for (auto const& p : points)
+    {
+        xmin = std::min(xmin, p.X());
+        xmax = std::max(xmax, p.X());
+        ymin = std::min(ymin, p.Y());
+        ymax = std::max(ymax, p.Y());
+    }
+
+    auto span = std::max(xmax - xmin, ymax - ymin);
+    auto scale = (span > 0) ? ((1 << bits) - 1) / span : 0;
+
+    return CurveOrder(points.size(), bits, curve, [&](size_t i, uint32_t& x, uint32_t& y) {
+        x = static_cast<uint32_t>((points[i].X() - xmin) * scale + static_cast<T>(0.5));
+        y = static_cast<uint32_t>((points[i].Y() - ymin) * scale + static_cast<T>(0.5));
+    });
+}
@@ -0,0 +1,199 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+
+#include <assert.h>
+#include <math.h>
+#include "Array2D.h"
+#include "Vector3.h"
+
+// A set of sample points on the target surface, laid out as rows x cols so
+// the intensity can be returned as an Array2D of the same shape.
+// The footprint is in the x - y plane around the center of the array, and
+// the points are projected directly upward onto the target plane at distance.
+template<typename T>
+class TargetGeometry
+{
+public:
+    virtual ~TargetGeometry() {}
+
+    virtual int rows() const = 0;
+    virtual int cols() const = 0;
+    virtual Point3<T> Point(int row, int col) const = 0;
+
+    size_t size() const
+    {
+        return static_cast<size_t>(rows()) * cols();
+    }
+
+    // Point index of the row major layout, made from the index on demand,
+    // so a target never has to be held in memory
+    Point3<T> PointAt(size_t index) const
+    {
+        auto ncols = static_cast<size_t>(cols());
+        return Point(static_cast<int>(index / ncols), static_cast<int>(index % ncols));
+    }
+
+    // Every point at once; only for targets small enough to hold
+    Array2D<Point3<T>> Points() const
+    {
+        Array2D<Point3<T>> data(rows(), cols());
+
+        auto iter = data.begin();
+        for (int row = 0; row < rows(); ++row)
+        {
+            for (int col = 0; col < cols(); ++col, ++iter)
+            {
+                *iter = Point(row, col);
+            }
+        }
+
+        return data;
+    }
+};
+
+// square grid, with equal spacing in x and y, centered around the origin
+// (or around centerX, centerY)
+//npts = 100;
+//gmin = -3;
+//gmax = -gmin;
+//deltag = (gmax - gmin) / (npts - 1);
+//gv = (gmin:deltag:gmax)';
+//[X, Y] = meshgrid(gv, gv);
+template<typename T>
+class GridTarget : public TargetGeometry<T>
+{
+public:
+    GridTarget(int side, T extent, T distance, T centerX = 0, T centerY = 0) :
+        side(side), extent(extent), distance(distance), centerX(centerX), centerY(centerY),
+        increment(2 * extent / (side - 1))
+    {
+        assert(side > 1);
+        assert(extent > 0);
+    }
+
+    int rows() const override { return side; }
+    int cols() const override { return side; }
+
+    Point3<T> Point(int row, int col) const override
+    {
+        return Point3<T>(col * increment - extent + centerX, row * increment - extent + centerY, distance);
+    }
+
+private:
+    int side;
+    T extent;
+    T distance;
+    T centerX;
+    T centerY;
+    T increment;
+};
+
+// 1D cut through the center of the footprint at angle (radians) from the
+// x-axis, running from -extent to extent; a single row of npts points
+template<typename T>
+class LineCutTarget : public TargetGeometry<T>
+{
+public:
+    LineCutTarget(int npts, T extent, T angle, T distance) :
+        npts(npts), extent(extent), distance(distance),
+        cosAngle(static_cast<T>(cos(angle))), sinAngle(static_cast<T>(sin(angle))),
+        increment(2 * extent / (npts - 1))
+    {
+        assert(npts > 1);
+        assert(extent > 0);
+    }
+
+    int rows() const override { return 1; }
+    int cols() const override { return npts; }
+
+    Point3<T> Point(int, int col) const override
+    {
+        auto s = col * increment - extent;
+        return Point3<T>(s * cosAngle, s * sinAngle, distance);
+    }
+
+private:
+    int npts;
+    T extent;
+    T distance;
+    T cosAngle;
+    T sinAngle;
+    T increment;
+};
+
+// polar grid; each row is a ring of constant radius, from the center out to
+// extent, and each column is a spoke.  The array from ArraySetup has six fold
+// symmetry, so with symmetry = 6 only one 60 degree wedge is sampled.
+template<typename T>
+class PolarTarget : public TargetGeometry<T>
+{
+public:
+    PolarTarget(int nradii, int nangles, T extent, T distance, int symmetry = 1) :
+        nradii(nradii), nangles(nangles), distance(distance),
+        deltaR(extent / (nradii - 1)),
+        deltaTheta(static_cast<T>(2 * M_PI / (symmetry * nangles)))
+    {
+        assert(nradii > 1);
+        assert(nangles > 0);
+        assert(extent > 0);
+        assert(symmetry > 0);
+    }
+
+    int rows() const override { return nradii; }
+    int cols() const override { return nangles; }
+
+    Point3<T> Point(int row, int col) const override
+    {
+        auto radius = row * deltaR;
+        auto theta = col * deltaTheta;
+        return Point3<T>(
+            static_cast<T>(radius * cos(theta)),
+            static_cast<T>(radius * sin(theta)),
+            distance);
+    }
+
+private:
+    int nradii;
+    int nangles;
+    T distance;
+    T deltaR;
+    T deltaTheta;
+};
+
+// hexagonal grid with the same row spacing as the square grid of the same
+// side, and points 2 / sqrt(3) further apart along each row; alternate rows
+// are offset by half a point.  This has the same alias-free bandwidth as the
+// square grid with sqrt(3) / 2 as many points.
+template<typename T>
+class HexTarget : public TargetGeometry<T>
+{
+public:
+    HexTarget(int side, T extent, T distance) :
+        side(side), extent(extent), distance(distance),
+        rowIncrement(2 * extent / (side - 1)),
+        colIncrement(static_cast<T>(rowIncrement * 2 / sqrt(3)))
+    {
+        assert(side > 1);
+        assert(extent > 0);
+
+        ncols = static_cast<int>(floor(2 * extent / colIncrement)) + 1;
+    }
+
+    int rows() const override { return side; }
+    int cols() const override { return ncols; }
+
+    Point3<T> Point(int row, int col) const override
+    {
+        auto offset = (row & 1) ? colIncrement / 2 : 0;
+        return Point3<T>(col * colIncrement + offset - extent, row * rowIncrement - extent, distance);
+    }
+
+private:
+    int side;
+    int ncols;
+    T extent;
+    T distance;
+    T rowIncrement;
+    T colIncrement;
+};
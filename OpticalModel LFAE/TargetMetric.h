@@ -0,0 +1,113 @@
+#pragma once
+
+#include <algorithm>
+#include <assert.h>
+#include <vector>
+#include "Array2D.h"
+#include "TargetGeometry.h"
+
+// Target metrics of the form M = SUM(Q) w(Q) I(Q), given by the weight of
+// each target point, in the row major order of TargetGeometry::PointAt().
+// The gradient of any such metric with respect to the lens phases comes from
+// the same weights - see PartialFieldCache::MetricGradient.
+
+// 1 at the brightest point of I, 0 elsewhere, so M is the peak intensity
+template<typename T>
+std::vector<T> PeakWeights(Array2D<T> const& I)
+{
+    assert(I.size() > 0);
+
+    std::vector<T> weights(I.size(), 0);
+    size_t peak = 0;
+    auto iter = I.begin();
+    for (size_t q = 0; q < I.size(); ++q, ++iter)
+    {
+        if (*iter > *(I.begin() + peak))
+        {
+            peak = q;
+        }
+    }
+
+    weights[peak] = 1;
+    return weights;
+}
+
+// 1 inside a circle of radius around (centerX, centerY) on the target plane,
+// so M is the power in the bucket in units of the sample area
+template<typename T>
+std::vector<T> BucketWeights(TargetGeometry<T> const& target, T centerX, T centerY, T radius)
+{
+    std::vector<T> weights;
+    weights.reserve(target.size());
+
+    for (int row = 0; row < target.rows(); ++row)
+    {
+        for (int col = 0; col < target.cols(); ++col)
+        {
+            auto Q = target.Point(row, col);
+            auto dx = Q.X() - centerX;
+            auto dy = Q.Y() - centerY;
+            weights.push_back((dx * dx + dy * dy <= radius * radius) ? T(1) : T(0));
+        }
+    }
+
+    return weights;
+}
+
+// Summary of one intensity map: peak, total power, power within a bucket
+// (BucketWeights) and the intensity weighted centroid on the target plane
+template<typename T>
+struct TargetSummary
+{
+    T peak;
+    T power;
+    T bucket_power;
+    T centroid_x;
+    T centroid_y;
+};
+
+template<typename T>
+TargetSummary<T> Summarize(TargetGeometry<T> const& target, Array2D<T> const& I, std::vector<T> const& bucket)
+{
+    assert(I.size() == target.size());
+    assert(bucket.size() == target.size());
+
+    TargetSummary<T> summary = { 0, 0, 0, 0, 0 };
+    auto iter = I.begin();
+    size_t q = 0;
+    for (int row = 0; row < target.rows(); ++row)
+    {
+        for (int col = 0; col < target.cols(); ++col, ++iter, ++q)
+        {
+            auto Q = target.Point(row, col);
+            summary.peak = std::max(summary.peak, *iter);
+            summary.power += *iter;
+            summary.bucket_power += bucket[q] * *iter;
+            summary.centroid_x += Q.X() * *iter;
+            summary.centroid_y += Q.Y() * *iter;
+        }
+    }
+
+    if (summary.power > 0)
+    {
+        summary.centroid_x /= summary.power;
+        summary.centroid_y /= summary.power;
+    }
+
+    return summary;
+}
+
+template<typename T>
+T WeightedMetric(std::vector<T> const& weights, Array2D<T> const& I)
+{
+    assert(weights.size() == I.size());
+
+    T metric = 0;
+    auto iter = I.begin();
+    for (size_t q = 0; q < weights.size(); ++q, ++iter)
+    {
+        metric += weights[q] * *iter;
+    }
+
+    return metric;
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "DataType.h"
+#include "MappedFile.h"
+
+// An arbitrary (non-planar) target surface given as a flat list of points
+// Points are produced on demand from the index, so a source never has to
+// hold the whole target in memory.
+class TargetSource
+{
+public:
+    virtual ~TargetSource() {}
+
+    virtual size_t size() const = 0;
+    virtual pointType Point(size_t index) const = 0;
+};
+
+// Binary point list - consecutive little-endian double x, y, z triples,
+// in meters, with no header
+class TargetPointFile : public TargetSource
+{
+public:
+    explicit TargetPointFile(std::string const& filename) : m_file(filename)
+    {
+        if (m_file.size() % RecordSize != 0)
+        {
+            throw "'CheckData:InputError', ' point file is not a list of x, y, z doubles'";
+        }
+    }
+
+    size_t size() const override
+    {
+        return m_file.size() / RecordSize;
+    }
+
+    pointType Point(size_t index) const override
+    {
+        double xyz[3];
+        memcpy(xyz, m_file.data() + index * RecordSize, sizeof(xyz));
+
+        return pointType(xyz[0], xyz[1], xyz[2]);
+    }
+
+private:
+    static const size_t RecordSize = 3 * sizeof(double);
+
+    MappedFile m_file;
+};
+
+// Binary STL triangle mesh; the target points are the facet centers
+// Layout is an 80 byte header, a uint32 facet count, then 50 byte records of
+// float normal[3], float vertex[3][3] and a uint16 attribute count
+class TargetStlFile : public TargetSource
+{
+public:
+    explicit TargetStlFile(std::string const& filename) : m_file(filename), m_facets(0)
+    {
+        if (m_file.size() >= HeaderSize)
+        {
+            uint32_t facets;
+            memcpy(&facets, m_file.data() + HeaderSize - sizeof(facets), sizeof(facets));
+            m_facets = facets;
+        }
+
+        if (m_file.size() < HeaderSize || m_file.size() != HeaderSize + m_facets * RecordSize)
+        {
+            throw "'CheckData:InputError', ' not a binary STL file'";
+        }
+    }
+
+    size_t size() const override
+    {
+        return m_facets;
+    }
+
+    pointType Point(size_t index) const override
+    {
+        float vertex[9];
+        memcpy(vertex, m_file.data() + HeaderSize + index * RecordSize + 3 * sizeof(float), sizeof(vertex));
+
+        return pointType(
+            (static_cast<floatType>(vertex[0]) + vertex[3] + vertex[6]) / 3,
+            (static_cast<floatType>(vertex[1]) + vertex[4] + vertex[7]) / 3,
+            (static_cast<floatType>(vertex[2]) + vertex[5] + vertex[8]) / 3);
+    }
+
+private:
+    static const size_t HeaderSize = 84;
+    static const size_t RecordSize = 50;
+
+    MappedFile m_file;
+    size_t m_facets;
+};
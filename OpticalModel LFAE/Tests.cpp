@@ -1,8 +1,26 @@
 #include "stdafx.h"
 
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+#include <string.h>
+#include <string>
+
+#include "Apodization.h"
 #include "ArraySetup.h"
 #include "ClosePackCenters.h"
+#include "CounterRng.h"
+#include "LensGeometry.h"
+#include "LensSampling.h"
+#include "NearField.h"
+#include "NearField_R00.h"
+#include "PartialFieldCache.h"
+#include "PhaseScreen.h"
+#include "SpaceFillingCurve.h"
+#include "TargetGeometry.h"
+#include "TargetMetric.h"
 #include "VectorMath.h"
+#include "Zernike.h"
 #include "tests.h"
 
 using namespace VectorMath;
@@ -15,7 +33,33 @@ bool RunTests()
     assert(TestRotate3d());
     assert(TestPointPlaneNormalDistance());
     assert(TestClosePackCenters());
+    assert(TestLensSampling());
+    assert(TestTargetGeometry());
+    assert(TestTargetMetric());
+    assert(TestZernike());
+    assert(TestApodization());
+    assert(TestPhilox());
+    assert(TestSpaceFillingCurve());
     assert(TestArraySetup());
+    assert(TestArray2D());
+    assert(TestVolumeSlice());
+    assert(TestPartialFieldCache());
+    assert(TestMetricGradient());
+    assert(TestPhaseScreen());
+    assert(TestWeakTurbulence());
+    assert(TestMonteCarloThreads());
+    assert(TestZeroNoiseTiltedArray());
+    assert(TestFovCulling());
+    assert(TestTargetSource());
+    assert(TestRegions());
+    assert(TestTileCache());
+    assert(TestEvaluatePhases());
+    assert(TestSpgd());
+    assert(TestPhaseRetrieval());
+    assert(TestFailureScan());
+    assert(TestTransientPhaseNoise());
+    assert(TestLensGeometry());
+    assert(TestApodizationThreshold());
 
     return true;
 }
@@ -84,6 +128,19 @@ bool TestRotate3d()
     passed = passed && ApproximatelyEqual(RotatePoint3d(center, theta, axis, point), FloatVector(0, 1, 0));
     passed = passed && ApproximatelyEqual(RotatePoint3d(center, -theta, axis, point), FloatVector(0, -1, 0));
 
+    // the batched form rotates then translates, and (as SetupArray uses it)
+    // carries z onto oa when turning by -acos(oa . z) about oa x z
+    FloatVector z(0, 0, 1);
+    auto oa = FloatVector(1, 0, 1).Normalize();
+    auto raxis = CrossProduct(oa, z).Normalize();
+    auto rotation = RotationMatrix(-acosf(DotProduct(oa, z)), raxis);
+
+    FloatPoint in[2] = { z, FloatPoint(0, 1, 0) };
+    FloatPoint out[2];
+    RotateTranslatePoints(rotation, FloatVector(1, 2, 3), in, out, 2);
+    passed = passed && ApproximatelyEqual(out[0], oa + FloatVector(1, 2, 3));
+    passed = passed && ApproximatelyEqual(out[1], FloatPoint(1, 3, 3));
+
     return passed;
 }
 
@@ -107,6 +164,173 @@ bool TestClosePackCenters()
 
     auto centers = ClosePackCenters<float>(4, 10, rad);
 
+    // the lattice gives the same centers, in the same order, from the index
+    ClosePackLattice<float> lattice(4, 10);
+    passed = passed && lattice.size() == centers.size();
+    for (size_t i = 0; passed && i < centers.size(); ++i)
+    {
+        auto p = lattice[i];
+        passed = p.X() == centers[i].X() && p.Y() == centers[i].Y() && p.Z() == centers[i].Z();
+    }
+
+    // every circle fits in the aperture, and no two overlap
+    for (size_t i = 0; passed && i < centers.size(); ++i)
+    {
+        passed = centers[i].Norm() + rad <= 10 * 1.0001f;
+        for (size_t j = 0; passed && j < i; ++j)
+        {
+            passed = (centers[i] - centers[j]).Norm() >= 2 * rad * 0.9999f;
+        }
+    }
+
+    return passed;
+}
+
+bool TestLensSampling()
+{
+    bool passed = true;
+
+    float rad;
+    float outer_rad = 10;
+
+    auto fibonacci = FibonacciSpiralCenters<float>(200, outer_rad, rad);
+    auto sobol = SobolDiskCenters<float>(200, outer_rad, rad);
+
+    passed = passed && fibonacci.size() == 200;
+    passed = passed && sobol.size() == 200;
+
+    // every sample lies inside the aperture, and the equal-area samples
+    // should leave the centroid close to the lens center
+    for (auto const& samples : { fibonacci, sobol })
+    {
+        FloatPoint centroid;
+        for (auto const& p : samples)
+        {
+            passed = passed && p.Norm() <= outer_rad;
+            centroid = centroid + p;
+        }
+
+        passed = passed && (centroid / static_cast<float>(samples.size())).Norm() < 0.05f * outer_rad;
+    }
+
+    return passed;
+}
+
+bool TestTargetGeometry()
+{
+    bool passed = true;
+
+    GridTarget<float> grid(11, 1, 100);
+    passed = passed && grid.size() == 121;
+    passed = passed && ApproximatelyEqual(grid.Point(0, 0), FloatPoint(-1, -1, 100));
+    passed = passed && ApproximatelyEqual(grid.Point(10, 10), FloatPoint(1, 1, 100));
+    passed = passed && ApproximatelyEqual(grid.Point(5, 5), FloatPoint(0, 0, 100));
+
+    GridTarget<float> window(11, 1, 100, 2, -3);
+    passed = passed && ApproximatelyEqual(window.Point(5, 5), FloatPoint(2, -3, 100));
+    passed = passed && ApproximatelyEqual(window.Point(0, 10), FloatPoint(3, -4, 100));
+
+    LineCutTarget<float> line(11, 1, static_cast<float>(M_PI_2), 100);
+    passed = passed && line.rows() == 1 && line.cols() == 11;
+    passed = passed && ApproximatelyEqual(line.Point(0, 10), FloatPoint(0, 1, 100));
+
+    PolarTarget<float> polar(11, 10, 1, 100, 6);
+    passed = passed && ApproximatelyEqual(polar.Point(0, 3), FloatPoint(0, 0, 100));
+    passed = passed && ApproximatelyEqual(polar.Point(10, 0), FloatPoint(1, 0, 100));
+
+    // same row count as the square grid, sqrt(3) / 2 as many points per row
+    HexTarget<float> hex(101, 1, 100);
+    passed = passed && hex.rows() == 101 && hex.cols() == 87;
+    passed = passed && hex.Points().size() == hex.size();
+
+    // points made from the row major index are the stored points
+    auto points = hex.Points();
+    for (size_t q = 0; passed && q < hex.size(); q += 37)
+    {
+        auto p = hex.PointAt(q);
+        auto stored = *(points.begin() + q);
+        passed = p.X() == stored.X() && p.Y() == stored.Y() && p.Z() == stored.Z();
+    }
+
+    return passed;
+}
+
+bool TestTargetMetric()
+{
+    bool passed = true;
+
+    GridTarget<float> grid(5, 2, 100);
+    Array2D<float> I(5, 5);
+    for (size_t q = 0; q < I.size(); ++q)
+    {
+        *(I.begin() + q) = static_cast<float>(q % 7);
+    }
+
+    // first of the brightest points
+    auto peak = PeakWeights(I);
+    passed = passed && peak[6] == 1 && WeightedMetric(peak, I) == 6;
+
+    // center point and its four neighbours, 1 apart
+    auto bucket = BucketWeights<float>(grid, 0, 0, 1.1f);
+    passed = passed && WeightedMetric(bucket, I) == I[2][2] + I[1][2] + I[3][2] + I[2][1] + I[2][3];
+
+    // all of the power in one point
+    Array2D<float> spot(5, 5);
+    spot[1][3] = 2;
+    auto summary = Summarize(grid, spot, bucket);
+    passed = passed && summary.peak == 2 && summary.power == 2 && summary.bucket_power == 0;
+    passed = passed && ApproximatelyEqual(summary.centroid_x, 1.0f) && ApproximatelyEqual(summary.centroid_y, -1.0f);
+
+    return passed;
+}
+
+bool TestZernike()
+{
+    bool passed = true;
+
+    passed = passed && ApproximatelyEqual(Zernike(1, 0.3f, 1.0f), 1.0f);
+    passed = passed && ApproximatelyEqual(Zernike(2, 1.0f, 0.0f), 2.0f);
+    passed = passed && ApproximatelyEqual(Zernike(3, 1.0f, static_cast<float>(M_PI_2)), 2.0f);
+    passed = passed && ApproximatelyEqual(Zernike(4, 0.0f, 0.0f), -sqrtf(3));
+    passed = passed && ApproximatelyEqual(Zernike(11, 1.0f, 0.0f), sqrtf(5));
+
+    // astigmatism: sin 2 theta for 5, cos 2 theta for 6
+    passed = passed && ApproximatelyEqual(Zernike(5, 1.0f, static_cast<float>(M_PI_4)), sqrtf(6));
+    passed = passed && ApproximatelyEqual(Zernike(6, 1.0f, 0.0f), sqrtf(6));
+
+    std::vector<FloatPoint> points = { FloatPoint(0, 0, 0), FloatPoint(2, 0, 0) };
+    auto basis = ZernikeBasis(points, 2.0f, 4);
+    passed = passed && basis.rows() == 2 && basis.cols() == 4;
+    passed = passed && ApproximatelyEqual(basis(1, 1), 2.0f);
+
+    return passed;
+}
+
+bool TestPhilox()
+{
+    bool passed = true;
+
+    // Random123 known answers for philox4x32-10
+    uint32_t zeros[4] = { 0, 0, 0, 0 };
+    uint32_t out[4];
+    Philox4x32::Block(zeros, zeros, out);
+    passed = passed && out[0] == 0x6627e8d5 && out[1] == 0xe169c58d && out[2] == 0xbc57ac4c && out[3] == 0x9b00dbd8;
+
+    uint32_t ones[4] = { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff };
+    Philox4x32::Block(ones, ones, out);
+    passed = passed && out[0] == 0x408f276d && out[1] == 0x41c83b0e && out[2] == 0xa20bc7c6 && out[3] == 0x6d5451fd;
+
+    // a stream is the same however it is reached, and differs from its
+    // neighbours
+    Philox4x32 a(7, 3, 5);
+    Philox4x32 b(7, 3, 5);
+    Philox4x32 c(7, 3, 6);
+    for (int draw = 0; draw < 10; ++draw)
+    {
+        auto u = a.Uniform();
+        passed = passed && u == b.Uniform() && u != c.Uniform() && u >= 0 && u < 1;
+    }
+
     return passed;
 }
 
@@ -116,5 +340,999 @@ bool TestArraySetup()
 
     auto centers = ArraySetup<float>(6, .3f);
 
+    // 3 n (n + 1) lenses around the center one
+    ArrayLattice<float> lattice(6, .3f);
+    passed = passed && centers.size() == 127 && lattice.size() == centers.size();
+
+    // any part of the array can be produced on its own
+    for (size_t i = centers.size(); passed && i-- > 0; )
+    {
+        auto p = lattice[i];
+        passed = p.X() == centers[i].X() && p.Y() == centers[i].Y() && p.Z() == centers[i].Z();
+    }
+
+    // neighbours are one pitch apart, and no two lenses coincide
+    auto nearest = std::numeric_limits<float>::max();
+    for (size_t i = 0; i < centers.size(); ++i)
+    {
+        for (size_t j = 0; j < i; ++j)
+        {
+            nearest = std::min(nearest, (centers[i] - centers[j]).Norm());
+        }
+    }
+    passed = passed && ApproximatelyEqual(nearest, .3f);
+
+    return passed;
+}
+
+bool TestSpaceFillingCurve()
+{
+    bool passed = true;
+
+    passed = passed && MortonKey(1, 0) == 1 && MortonKey(0, 1) == 2 && MortonKey(3, 3) == 15;
+    passed = passed && MortonKey(0xFFFFFFFF, 0) == 0x5555555555555555ull;
+
+    // the Hilbert curve visits every cell once, stepping to a neighbour each time
+    auto hilbert = GridCurveOrder(16, 16, "hilbert");
+    passed = passed && hilbert.size() == 256 && hilbert[0] == 0;
+    for (size_t i = 1; passed && i < hilbert.size(); ++i)
+    {
+        auto step = abs(static_cast<int>(hilbert[i] % 16) - static_cast<int>(hilbert[i - 1] % 16)) +
+            abs(static_cast<int>(hilbert[i] / 16) - static_cast<int>(hilbert[i - 1] / 16));
+        passed = step == 1;
+    }
+
+    // orders are permutations, also when the array is not a power of two square
+    for (auto curve : { "native", "morton", "hilbert" })
+    {
+        auto order = GridCurveOrder(5, 7, curve);
+        std::vector<bool> seen(order.size());
+        for (auto q : order)
+        {
+            passed = passed && q < seen.size() && !seen[q];
+            seen[q] = true;
+        }
+        passed = passed && order.size() == 35;
+    }
+
+    passed = passed && GridCurveOrder(3, 3, "native")[4] == 4;
+
+    // lens points sorted by position; the first four Morton cells of a 2 x 2
+    // square in Z order
+    std::vector<Point3<float>> points = {
+        Point3<float>(1, 1, 0), Point3<float>(0, 1, 0), Point3<float>(1, 0, 0), Point3<float>(0, 0, 0) };
+    auto morton = PointCurveOrder(points, "morton");
+    passed = passed && morton == std::vector<size_t>({ 3, 2, 1, 0 });
+
+    return passed;
+}
+
+bool TestArray2D()
+{
+    bool passed = true;
+
+    // rows of 5 doubles padded to a whole cache line each
+    Array2D<double> padded(3, 5, true);
+    passed = passed && padded.padded() && padded.stride() == 8 && padded.size() == 15;
+    for (int row = 0; row < padded.rows(); ++row)
+    {
+        passed = passed && reinterpret_cast<uintptr_t>(padded[row].data()) % 64 == 0;
+        for (int col = 0; col < padded.cols(); ++col)
+        {
+            padded[row][col] = 10 * row + col;
+        }
+    }
+
+    Array2D<double> const& view = padded;
+    passed = passed && view(2, 4) == 24 && view[1][3] == 13;
+
+    // a window shares the storage of the array
+    auto window = padded.Window(1, 2, 2, 3);
+    passed = passed && window(0, 0) == 12 && window[1][2] == 24 && window.stride() == 8;
+    window(1, 0) = -1;
+    passed = passed && view(2, 2) == -1;
+
+    Array2D<float> flat(4, 3);
+    passed = passed && !flat.padded() && flat.end() - flat.begin() == 12;
+
+    // pages from the system start out zero
+    Array2D<double, PageAllocator<double>> pages(512, 512);
+    for (int row = 0; passed && row < pages.rows(); row += 97)
+    {
+        passed = pages(row, row) == 0;
+    }
+
+    // elements added by resize are value initialized even where the pages
+    // held other values
+    std::vector<double, PageAllocator<double>> reused(1024, 5.0);
+    reused.resize(1);
+    reused.resize(1024);
+    passed = passed && reused.front() == 5 && reused.back() == 0;
+
+    return passed;
+}
+
+bool TestApodization()
+{
+    bool passed = true;
+
+    // far from the tip the beam grows at the diffraction angle lambda / (pi w0)
+    double w0 = 5e-6;
+    double lambda = 1e-6;
+    double NA = 0.1;
+    double Rlens = 0.01;
+    auto f = Rlens / tan(asin(NA));
+    auto w = GaussianBeamRadius(2 * w0, NA, lambda, Rlens);
+    passed = passed && fabs(w / (f * lambda / (M_PI * w0)) - 1) < 1e-6;
+
+    // the same fraction of any lens
+    passed = passed && fabs(GaussianBeamRadius(2 * w0, NA, lambda, 3 * Rlens) / w - 3) < 1e-6;
+
+    passed = passed && GaussianAmplitude(0.0, w) == 1;
+    passed = passed && fabs(GaussianAmplitude(w, w) - exp(-1.0)) < 1e-12;
+
+    return passed;
+}
+
+// A seven lens array with a coarse lens discretization and a 9 x 9 target,
+// small enough to run the full near field sums in a test
+static NearField SmallNearField()
+{
+    NearField n;
+    n.n_lens_shells = 1;
+    n.n_discr_shells = 3;
+    n.npts = 9;
+    n.gmax = 1;
+    n.m_threadCount = 3;
+
+    return n;
+}
+
+// every intensity within tolerance of the peak of expected
+static bool SameIntensity(Array2D<floatType> const& expected, Array2D<floatType> const& actual, floatType tolerance)
+{
+    if (expected.rows() != actual.rows() || expected.cols() != actual.cols())
+    {
+        return false;
+    }
+
+    auto peak = *std::max_element(expected.begin(), expected.end());
+    for (size_t index = 0; index < expected.size(); ++index)
+    {
+        if (fabs(expected.begin()[index] - actual.begin()[index]) > tolerance * peak)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool TestVolumeSlice()
+{
+    auto n = SmallNearField();
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    // the slice works out QiPi and t_i its own way, so it agrees with R00 to
+    // the rounding of a k t_i phase of ~1e10 rad, not bit for bit
+    auto slices = n.R00Volume(*target, std::vector<floatType>(1, n.target_surf_dist));
+
+    return slices.size() == 1 && SameIntensity(I, slices[0], 1e-6);
+}
+
+bool TestPartialFieldCache()
+{
+    std::vector<floatType> phases = { 0.3, -1.2, 2.0, 0.0, 0.7, -0.4, 1.5 };
+
+    // the same phases as Zernike piston terms of an R00 run
+    auto n = SmallNearField();
+    for (auto phase : phases)
+    {
+        n.zernike_coefficients.push_back(std::vector<floatType>(1, phase));
+    }
+
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    // the lens fields held in memory, then all spilled to the file
+    bool passed = true;
+    for (auto budget : { 1024, 0 })
+    {
+        auto cached = SmallNearField();
+        cached.partial_field_budget_mb = budget;
+        PartialFieldCache cache(cached, *target);
+
+        auto lensPhases = phases;
+        passed = passed && cache.Lenses() == static_cast<int>(phases.size());
+        passed = passed && SameIntensity(I, cache.SetLensPhases(lensPhases), 1e-6);
+
+        // a single lens update agrees with R00 for the new phases too
+        lensPhases[2] = -0.5;
+        auto moved = n;
+        moved.zernike_coefficients[2][0] = lensPhases[2];
+        passed = passed && SameIntensity(moved.R00(*target), cache.SetLensPhase(2, lensPhases[2]), 1e-6);
+    }
+
+    // lens_phases of the wrong length is rejected and leaves no spill file
+    auto wrong = SmallNearField();
+    wrong.partial_field_budget_mb = 0;
+    wrong.lens_phases.assign(phases.size() + 1, 0);
+    bool rejected = false;
+    try
+    {
+        PartialFieldCache cache(wrong, *target);
+    }
+    catch (char const*)
+    {
+        rejected = true;
+    }
+
+    FILE* spill;
+    fopen_s(&spill, wrong.partial_field_spill_file.c_str(), "rb");
+    if (spill)
+    {
+        fclose(spill);
+    }
+
+    return passed && rejected && !spill;
+}
+
+bool TestMetricGradient()
+{
+    auto n = SmallNearField();
+    auto target = n.MakeTarget();
+    PartialFieldCache cache(n, *target);
+
+    std::vector<floatType> phases = { 0.3, -1.2, 2.0, 0.0, 0.7, -0.4, 1.5 };
+    cache.SetLensPhases(phases);
+
+    // an uneven weighting, so no lens is special
+    std::vector<floatType> weights(cache.Points());
+    for (size_t q = 0; q < weights.size(); ++q)
+    {
+        weights[q] = 1 + static_cast<floatType>(q % 5);
+    }
+
+    std::vector<floatType> gradient;
+    auto metric = cache.MetricGradient(weights, gradient);
+    bool passed = fabs(metric / cache.EvaluateMetric(weights, phases) - 1) < 1e-12;
+
+    // central differences
+    floatType h = 1e-5;
+    floatType largest = 0;
+    std::vector<floatType> difference(phases.size());
+    for (size_t lens = 0; lens < phases.size(); ++lens)
+    {
+        auto plus = phases;
+        auto minus = phases;
+        plus[lens] += h;
+        minus[lens] -= h;
+        difference[lens] = (cache.EvaluateMetric(weights, plus) - cache.EvaluateMetric(weights, minus)) / (2 * h);
+        largest = std::max(largest, fabs(difference[lens]));
+    }
+
+    for (size_t lens = 0; lens < phases.size(); ++lens)
+    {
+        passed = passed && fabs(gradient[lens] - difference[lens]) < 1e-6 * largest;
+    }
+
+    return passed;
+}
+
+bool TestPhaseScreen()
+{
+    // Kolmogorov screen, no outer or inner scale
+    int n = 64;
+    floatType dx = 0.01;
+    floatType r0 = 0.1;
+    PhaseScreen generator(n, dx, r0, 0, 0, 3);
+
+    bool passed = true;
+    for (int separation : { 2, 4 })
+    {
+        // structure function D(r) = <(phase(x + r) - phase(x))^2>, over rows,
+        // columns and realizations
+        floatType D = 0;
+        int count = 0;
+        for (uint32_t realization = 0; realization < 20; ++realization)
+        {
+            auto screen = generator.Generate(1, realization);
+            for (int row = 0; row < n; ++row)
+            {
+                for (int col = 0; col + separation < n; ++col)
+                {
+                    auto dRow = screen(row, col + separation) - screen(row, col);
+                    auto dCol = screen(col + separation, row) - screen(col, row);
+                    D += dRow * dRow + dCol * dCol;
+                    count += 2;
+                }
+            }
+        }
+
+        // against 6.88 (r / r0)^(5/3); FFT screens come out a little low
+        // even with the subharmonics
+        auto ratio = D / count / (6.88 * pow(separation * dx / r0, 5.0 / 3));
+        passed = passed && ratio > 0.7 && ratio < 1.3;
+    }
+
+    return passed;
+}
+
+bool TestWeakTurbulence()
+{
+    auto n = SmallNearField();
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    // a screen with an enormous r0 leaves the phases as they were
+    n.n_screens = 2;
+    n.screen_points = 16;
+    n.screen_r0 = 1e9;
+    auto screens = n.R00Screens(*target);
+
+    bool passed = screens.size() == 2;
+    for (auto const& screen : screens)
+    {
+        passed = passed && SameIntensity(I, screen, 1e-6);
+    }
+
+    // too few points to span the array, or not a power of 2
+    for (auto points : { 2, 12 })
+    {
+        n.screen_points = points;
+        try
+        {
+            n.R00Screens(*target);
+            passed = false;
+        }
+        catch (char const*)
+        {
+        }
+    }
+
+    return passed;
+}
+
+// whole contents of a file, empty when it cannot be read
+static std::string ReadFile(std::string const& filename)
+{
+    std::string contents;
+
+    FILE* file;
+    fopen_s(&file, filename.c_str(), "rb");
+    if (file)
+    {
+        char buffer[4096];
+        size_t count;
+        while ((count = fread(buffer, 1, sizeof(buffer), file)) > 0)
+        {
+            contents.append(buffer, count);
+        }
+        fclose(file);
+    }
+
+    return contents;
+}
+
+bool TestMonteCarloThreads()
+{
+    auto n = SmallNearField();
+    n.mc_trials = 6;
+    auto target = n.MakeTarget();
+
+    // every trial draws from its own counter, so the per trial summaries
+    // are the same bits for one thread and several
+    n.m_threadCount = 1;
+    n.MonteCarlo(*target, "test_mc_1.csv");
+    n.m_threadCount = 4;
+    n.MonteCarlo(*target, "test_mc_4.csv");
+
+    auto one = ReadFile("test_mc_1.csv");
+    auto four = ReadFile("test_mc_4.csv");
+    remove("test_mc_1.csv");
+    remove("test_mc_4.csv");
+
+    return !one.empty() && one == four;
+}
+
+// the summary on the given line, first by default, of a MonteCarlo or
+// Transient output file, after skip leading columns
+static bool ReadSummary(std::string const& filename, int skip, TargetSummary<floatType>& s, int line = 0)
+{
+    auto contents = ReadFile(filename);
+    auto fields = contents.c_str();
+    for (int row = 0; row < line && fields; ++row)
+    {
+        fields = strchr(fields, '\n');
+        fields = fields ? fields + 1 : nullptr;
+    }
+
+    for (int column = 0; column < skip && fields; ++column)
+    {
+        fields = strchr(fields, ',');
+        fields = fields ? fields + 1 : nullptr;
+    }
+
+    return fields && sscanf_s(fields, "%lf, %lf, %lf, %lf, %lf",
+        &s.peak, &s.power, &s.bucket_power, &s.centroid_x, &s.centroid_y) == 5;
+}
+
+static bool SameSummary(TargetSummary<floatType> const& expected, TargetSummary<floatType> const& actual, floatType tolerance, floatType extent)
+{
+    return fabs(actual.peak - expected.peak) <= tolerance * expected.peak &&
+        fabs(actual.power - expected.power) <= tolerance * expected.power &&
+        fabs(actual.bucket_power - expected.bucket_power) <= tolerance * expected.peak &&
+        fabs(actual.centroid_x - expected.centroid_x) <= tolerance * extent &&
+        fabs(actual.centroid_y - expected.centroid_y) <= tolerance * extent;
+}
+
+bool TestZeroNoiseTiltedArray()
+{
+    // lenses pointed up to ~0.4 mrad off z, which moves their beams by a
+    // good part of the target at 1 km
+    auto n = SmallNearField();
+    for (int lens = 0; lens < 7; ++lens)
+    {
+        n.lens_axes.push_back({ 3e-4 * (lens % 3 - 1), 2e-4 * (lens % 2), 1.0 });
+    }
+
+    auto target = n.MakeTarget();
+    auto expected = Summarize(*target, n.R00(*target), BucketWeights<floatType>(*target, 0, 0, n.bucket_radius));
+
+    // with no misalignment or noise a trial and a step are the nominal array
+    n.mc_trials = 1;
+    n.mc_center_sigma = 0;
+    n.mc_tilt_sigma = 0;
+    n.mc_phase_sigma = 0;
+    n.MonteCarlo(*target, "test_mc_tilted.csv");
+
+    n.transient_steps = 2;
+    n.jitter_sigma = 0;
+    n.axis_drift_rate = 0;
+    n.phase_noise_sigma = 0;
+    n.Transient(*target, "test_transient_tilted.csv");
+
+    TargetSummary<floatType> trial, step;
+    bool passed = ReadSummary("test_mc_tilted.csv", 1, trial) && ReadSummary("test_transient_tilted.csv", 2, step);
+    remove("test_mc_tilted.csv");
+    remove("test_transient_tilted.csv");
+
+    return passed && SameSummary(expected, trial, 1e-6, n.gmax) && SameSummary(expected, step, 1e-6, n.gmax);
+}
+
+bool TestFovCulling()
+{
+    // 40 x 40 points make full and partial culling tiles
+    auto n = SmallNearField();
+    n.npts = 40;
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    // a cone wide enough to keep every lens for every tile sums the same
+    // lenses in the same order as the unculled R00
+    n.fov_margin = 1e6;
+    auto culled = n.R00(*target);
+    bool passed = SameIntensity(I, culled, 0) && n.fov_kept_fraction == 1;
+
+    // a cone of ~1 m at 1 km over an 8 m wide grid drops most lens / tile
+    // pairs; a point that every lens cone reaches still sums every lens
+    auto wide = SmallNearField();
+    wide.npts = 64;
+    wide.gmax = 4;
+    auto wideTarget = wide.MakeTarget();
+    auto Iwide = wide.R00(*wideTarget);
+    auto peak = *std::max_element(Iwide.begin(), Iwide.end());
+
+    wide.fov_margin = 200;
+    auto narrow = wide.R00(*wideTarget);
+    passed = passed && wide.fov_kept_fraction > 0 && wide.fov_kept_fraction < 1;
+
+    int inside = 0;
+    std::vector<int> lenses;
+    for (size_t q = 0; q < wideTarget->size(); ++q)
+    {
+        wide.VisibleLenses(wideTarget->PointAt(q), 0, lenses);
+        if (static_cast<int>(lenses.size()) == wide.n_lenses)
+        {
+            ++inside;
+            passed = passed && fabs(narrow.begin()[q] - Iwide.begin()[q]) <= 1e-9 * peak;
+        }
+    }
+
+    return passed && inside > 0;
+}
+
+bool TestTargetSource()
+{
+    auto n = SmallNearField();
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    // the grid points as a binary point list give the R00 intensities
+    std::vector<double> xyz;
+    for (size_t q = 0; q < target->size(); ++q)
+    {
+        auto Qi = target->PointAt(q);
+        xyz.insert(xyz.end(), { Qi.X(), Qi.Y(), Qi.Z() });
+    }
+
+    FILE* file;
+    fopen_s(&file, "test_points.bin", "wb");
+    bool passed = file != nullptr;
+    if (file)
+    {
+        fwrite(xyz.data(), sizeof(double), xyz.size(), file);
+        fclose(file);
+    }
+
+    // chunks smaller than the list, with a short last chunk
+    n.target_chunk_size = 10;
+    n.ShineOnTargetSource(TargetPointFile("test_points.bin"), "test_points.out");
+    auto intensity = ReadFile("test_points.out");
+    passed = passed && intensity.size() == I.size() * sizeof(double) &&
+        memcmp(intensity.data(), I.data(), intensity.size()) == 0;
+
+    // two facets of an STL mesh are evaluated at their centers
+    float facets[2][9] = {
+        { -0.5f, 0.0f, 1000.0f, 0.5f, 0.0f, 1000.0f, 0.0f, 0.75f, 1000.0f },
+        { 0.1f, 0.2f, 999.0f, 0.4f, 0.2f, 999.0f, 0.1f, 0.5f, 1002.0f } };
+
+    fopen_s(&file, "test_target.stl", "wb");
+    passed = passed && file != nullptr;
+    if (file)
+    {
+        char header[80] = "test mesh";
+        uint32_t count = 2;
+        float normal[3] = { 0, 0, 1 };
+        uint16_t attributes = 0;
+        fwrite(header, 1, sizeof(header), file);
+        fwrite(&count, sizeof(count), 1, file);
+        for (auto const& facet : facets)
+        {
+            fwrite(normal, sizeof(float), 3, file);
+            fwrite(facet, sizeof(float), 9, file);
+            fwrite(&attributes, sizeof(attributes), 1, file);
+        }
+        fclose(file);
+    }
+
+    TargetStlFile mesh("test_target.stl");
+    passed = passed && mesh.size() == 2;
+    n.ShineOnTargetSource(mesh, "test_target.out");
+    intensity = ReadFile("test_target.out");
+    passed = passed && intensity.size() == 2 * sizeof(double);
+    for (size_t facet = 0; passed && facet < 2; ++facet)
+    {
+        auto v = facets[facet];
+        auto center = pointType(
+            (static_cast<floatType>(v[0]) + v[3] + v[6]) / 3,
+            (static_cast<floatType>(v[1]) + v[4] + v[7]) / 3,
+            (static_cast<floatType>(v[2]) + v[5] + v[8]) / 3);
+
+        double value;
+        memcpy(&value, intensity.data() + facet * sizeof(double), sizeof(double));
+        passed = ApproximatelyEqual(mesh.Point(facet), center) && value == n.ShineOnTargetPoint(center);
+    }
+
+    remove("test_points.bin");
+    remove("test_points.out");
+    remove("test_target.stl");
+    remove("test_target.out");
+
+    return passed;
+}
+
+bool TestRegions()
+{
+    // regions of different sizes, so the thread strides cross region ends
+    auto n = SmallNearField();
+    n.m_threadCount = 4;
+    n.regions.resize(3);
+    n.regions[0].npts = 7;
+    n.regions[1].npts = 2;
+    n.regions[1].center_x = 1.5;
+    n.regions[1].extent = 0.25;
+    n.regions[2].npts = 5;
+    n.regions[2].center_y = -2;
+    n.regions[2].extent = 0.5;
+
+    auto targets = n.MakeRegionTargets();
+    auto I = n.R00Regions(targets);
+
+    // each region is evaluated exactly as R00 alone would
+    bool passed = I.size() == targets.size();
+    for (size_t region = 0; passed && region < targets.size(); ++region)
+    {
+        passed = SameIntensity(n.R00(*targets[region]), I[region], 0);
+    }
+
+    return passed;
+}
+
+bool TestTileCache()
+{
+    auto n = SmallNearField();
+    n.tile_cache_dir = ".";
+    n.tile_size = 4;
+    auto distance = n.target_surf_dist;
+
+    // a miss computes the window and stores its tiles
+    auto I = n.R00(GridTarget<floatType>(5, 1, distance));
+    bool passed = SameIntensity(I, n.R00Cached(5, 1), 1e-9);
+
+    // a hit reads them back; marking the stored tiles shows where the
+    // values came from
+    auto marked = std::vector<double>(n.tile_size * n.tile_size, 7.0);
+    for (auto const& name : n.CachedTileFiles(5, 1))
+    {
+        FILE* file;
+        fopen_s(&file, name.c_str(), "wb");
+        passed = passed && file != nullptr;
+        if (file)
+        {
+            fwrite(marked.data(), sizeof(double), marked.size(), file);
+            fclose(file);
+        }
+    }
+
+    auto cached = n.R00Cached(5, 1);
+    passed = passed && *std::min_element(cached.begin(), cached.end()) == 7 &&
+        *std::max_element(cached.begin(), cached.end()) == 7;
+
+    // other physics has its own tiles
+    auto other = n;
+    other.lambda *= 1.01;
+    passed = passed && SameIntensity(other.R00(GridTarget<floatType>(5, 1, distance)), other.R00Cached(5, 1), 1e-9);
+
+    // half the spacing takes every other point from the coarser tiles and
+    // computes the rest
+    auto fine = n.R00(GridTarget<floatType>(9, 1, distance));
+    auto refined = n.R00Cached(9, 1);
+    for (int row = 0; row < 9; ++row)
+    {
+        for (int col = 0; col < 9; ++col)
+        {
+            auto expected = (row % 2 == 0 && col % 2 == 0) ? 7 : fine[row][col];
+            passed = passed && fabs(refined[row][col] - expected) <= 1e-9 * expected;
+        }
+    }
+
+    // an even side is moved half a spacing onto the lattice
+    floatType h = 2.0 / 9;
+    passed = passed && SameIntensity(n.R00(GridTarget<floatType>(10, 1, distance, h / 2, h / 2)), n.R00Cached(10, 1), 1e-6);
+
+    for (auto const& window : { std::make_pair(5, &n), std::make_pair(9, &n), std::make_pair(10, &n), std::make_pair(5, &other) })
+    {
+        for (auto const& name : window.second->CachedTileFiles(window.first, 1))
+        {
+            remove(name.c_str());
+        }
+    }
+
+    return passed;
+}
+
+bool TestEvaluatePhases()
+{
+    std::vector<std::vector<floatType>> configurations = {
+        { 0, 0, 0, 0, 0, 0, 0 },
+        { 0.3, -1.2, 2.0, 0.0, 0.7, -0.4, 1.5 },
+        { 3.1, 0.2, -2.5, 1.1, -0.9, 0.4, -1.7 },
+    };
+
+    auto n = SmallNearField();
+    auto target = n.MakeTarget();
+    PartialFieldCache cache(n, *target);
+    auto I = cache.EvaluatePhases(configurations);
+
+    // each configuration against R00 with its phases as Zernike piston terms
+    bool passed = I.size() == configurations.size();
+    for (size_t config = 0; passed && config < configurations.size(); ++config)
+    {
+        auto pistons = SmallNearField();
+        for (auto phase : configurations[config])
+        {
+            pistons.zernike_coefficients.push_back(std::vector<floatType>(1, phase));
+        }
+
+        passed = SameIntensity(pistons.R00(*target), I[config], 1e-6);
+    }
+
+    return passed;
+}
+
+bool TestSpgd()
+{
+    auto n = SmallNearField();
+    n.spgd_iterations = 200;
+    n.spgd_gain = 20;
+    n.spgd_detector_npts = 5;
+    n.lens_phases = { 0.3, -1.2, 2.0, 0.0, 0.7, -0.4, 1.5 };
+
+    GridTarget<floatType> detector(n.spgd_detector_npts, n.bucket_radius, n.target_surf_dist);
+    auto weights = BucketWeights<floatType>(detector, 0, 0, n.bucket_radius);
+    PartialFieldCache cache(n, detector);
+    auto inPhase = cache.EvaluateMetric(weights, std::vector<floatType>(n.lens_phases.size(), 0));
+
+    std::vector<floatType> phases;
+    auto history = n.SimulateSpgd(phases);
+
+    // from scrambled phases the loop climbs past the array in phase, and
+    // ends at the metric of the phases it returns
+    return static_cast<int>(history.size()) == n.spgd_iterations &&
+        cache.EvaluateMetric(weights, n.lens_phases) < history.front() && history.back() > inPhase &&
+        fabs(cache.EvaluateMetric(weights, phases) / history.back() - 1) < 1e-12;
+}
+
+bool TestPhaseRetrieval()
+{
+    std::vector<floatType> truth = { 0.3, -1.2, 2.0, 0.0, 0.7, -0.4, 1.5 };
+
+    // the target is the intensity of known piston phases
+    auto n = SmallNearField();
+    for (auto phase : truth)
+    {
+        n.zernike_coefficients.push_back(std::vector<floatType>(1, phase));
+    }
+
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    auto retrieval = SmallNearField();
+    retrieval.retrieval_target.assign(I.begin(), I.end());
+    retrieval.retrieval_iterations = 50;
+
+    std::vector<floatType> phases;
+    auto history = retrieval.RetrievePhases(*target, phases);
+
+    // the error never rises, and falls well below that of the in phase
+    // start; Gerchberg - Saxton may stall short of the true phases
+    bool passed = static_cast<int>(history.size()) == retrieval.retrieval_iterations && history.back() < 0.6 * history.front();
+    for (size_t iteration = 1; iteration < history.size(); ++iteration)
+    {
+        passed = passed && history[iteration] <= history[iteration - 1] * (1 + 1e-9);
+    }
+
+    return passed;
+}
+
+// the FailureCase summary of a full evaluation
+static FailureCase Summarize(TargetGeometry<floatType> const& target, Array2D<floatType> const& I, floatType bucket_radius)
+{
+    auto bucket = BucketWeights<floatType>(target, 0, 0, bucket_radius);
+
+    FailureCase c = { -1, -1, 0, 0, 0 };
+    for (size_t q = 0; q < target.size(); ++q)
+    {
+        auto intensity = I.begin()[q];
+        c.peak = std::max(c.peak, intensity);
+        c.power += intensity;
+        c.bucket_power += bucket[q] * intensity;
+    }
+
+    return c;
+}
+
+static bool SameCase(FailureCase const& expected, FailureCase const& actual, floatType tolerance)
+{
+    return fabs(actual.peak - expected.peak) <= tolerance * expected.peak &&
+        fabs(actual.power - expected.power) <= tolerance * expected.power &&
+        fabs(actual.bucket_power - expected.bucket_power) <= tolerance * expected.bucket_power;
+}
+
+bool TestFailureScan()
+{
+    auto n = SmallNearField();
+    auto target = n.MakeTarget();
+    auto cases = n.FailureScan(*target);
+
+    bool passed = static_cast<int>(cases.size()) == n.n_lenses + 1 && cases[0].lens == -1 &&
+        SameCase(Summarize(*target, n.R00(*target), n.bucket_radius), cases[0], 1e-6);
+
+    // each dead lens against R00 of the array written without it
+    for (int dead = 0; dead < n.n_lenses; ++dead)
+    {
+        std::vector<LensRecord> records;
+        for (int lens = 0; lens < n.n_lenses; ++lens)
+        {
+            if (lens != dead)
+            {
+                auto const& c = n.oa_center[lens];
+                records.push_back({ { c.X(), c.Y(), c.Z() }, { 0, 0, 1 }, n.Dlens, 0 });
+            }
+        }
+
+        WriteLensGeometry("test_failure.bin", records);
+
+        // the reference plane stays anchored at the intact array's mean
+        // center, as a failed lens does not move it
+        auto remaining = SmallNearField();
+        remaining.lens_geometry_file = "test_failure.bin";
+        remaining.SetupArray();
+        remaining.refplane_anchor = n.refplane_anchor;
+
+        Array2D<floatType> I(target->rows(), target->cols());
+        for (size_t q = 0; q < target->size(); ++q)
+        {
+            I.begin()[q] = remaining.ShineOnTargetPoint(target->PointAt(q));
+        }
+
+        passed = passed && cases[dead + 1].lens == dead && cases[dead + 1].other_lens == -1 &&
+            SameCase(Summarize(*target, I, n.bucket_radius), cases[dead + 1], 1e-6);
+    }
+
+    remove("test_failure.bin");
+
+    return passed;
+}
+
+bool TestTransientPhaseNoise()
+{
+    auto n = SmallNearField();
+    n.transient_steps = 3;
+    n.jitter_sigma = 0;
+    n.axis_drift_rate = 0;
+    n.phase_noise_sigma = 0.5;
+
+    auto target = n.MakeTarget();
+    n.SetupArray();
+    std::vector<floatType> before(target->size());
+    for (size_t q = 0; q < target->size(); ++q)
+    {
+        before[q] = n.ShineOnTargetPoint(target->PointAt(q));
+    }
+
+    n.Transient(*target, "test_transient_noise.csv");
+
+    // the last step is the nominal phases plus that step's noise alone, as
+    // piston terms, not the noise of every step so far
+    auto last = static_cast<uint32_t>(n.transient_steps - 1);
+    auto pistons = SmallNearField();
+    for (int lens = 0; lens < n.n_lenses; ++lens)
+    {
+        Philox4x32 rng(n.transient_seed, last, static_cast<uint32_t>(lens));
+        rng.Normal();
+        rng.Normal();
+        rng.Normal();
+        pistons.zernike_coefficients.push_back(std::vector<floatType>(1, n.phase_noise_sigma * rng.Normal()));
+    }
+
+    auto expected = Summarize(*target, pistons.R00(*target), BucketWeights<floatType>(*target, 0, 0, n.bucket_radius));
+    TargetSummary<floatType> step;
+    bool passed = ReadSummary("test_transient_noise.csv", 2, step, last) && SameSummary(expected, step, 1e-6, n.gmax);
+    remove("test_transient_noise.csv");
+
+    // and the array is left as it was
+    for (size_t q = 0; q < target->size(); ++q)
+    {
+        passed = passed && n.ShineOnTargetPoint(target->PointAt(q)) == before[q];
+    }
+
     return passed;
-}
\ No newline at end of file
+}
+
+static bool SameRecords(std::vector<LensRecord> const& expected, std::string const& filename)
+{
+    LensGeometryFile geometry(filename);
+    return geometry.size() == expected.size() &&
+        memcmp(geometry.data() + LensGeometryFile::TagSize, expected.data(), expected.size() * sizeof(LensRecord)) == 0;
+}
+
+static void WriteText(std::string const& filename, char const* text)
+{
+    FILE* file;
+    fopen_s(&file, filename.c_str(), "wt");
+    if (file)
+    {
+        fputs(text, file);
+        fclose(file);
+    }
+}
+
+bool TestLensGeometry()
+{
+    std::vector<LensRecord> lenses = {
+        { { 0, 0, 0 }, { 0, 0, 1 }, 0.25, 0 },
+        { { 0.5, -0.75, 0.125 }, { 0.5, 0, 2 }, 0.125, 1.5 },
+    };
+
+    // binary write and map back
+    WriteLensGeometry("test_lenses.bin", lenses);
+    bool passed = SameRecords(lenses, "test_lenses.bin");
+
+    // a wrong tag or a partial record is rejected
+    for (auto text : { "LFAELENX", "LFAELENS1234" })
+    {
+        WriteText("test_lenses_bad.bin", text);
+        try
+        {
+            LensGeometryFile geometry("test_lenses_bad.bin");
+            passed = false;
+        }
+        catch (char const*)
+        {
+        }
+    }
+
+    // the same lenses as CSV, through the NearField_ImportLensGeometry entry
+    // point, and as JSON with the default axis and phase left out
+    WriteText("test_lenses.csv",
+        "# two lenses\n"
+        "x, y, z, ax, ay, az, diameter, phase\n"
+        "0, 0, 0, 0, 0, 1, 0.25, 0\n"
+        "0.5, -0.75, 0.125, 0.5, 0, 2, 0.125, 1.5\n");
+    WriteText("test_lenses_params.json", "{ \"lens_list_file\": \"test_lenses.csv\" }");
+    NearField_ImportLensGeometry("test_lenses_params.json", "test_lenses_csv.bin");
+    passed = passed && SameRecords(lenses, "test_lenses_csv.bin");
+
+    WriteText("test_lenses.json",
+        "[ { \"center\": [0, 0, 0], \"diameter\": 0.25 },\n"
+        "  { \"center\": [0.5, -0.75, 0.125], \"axis\": [0.5, 0, 2], \"diameter\": 0.125, \"phase\": 1.5 } ]\n");
+    ImportLensGeometry("test_lenses.json", "test_lenses_json.bin");
+    passed = passed && SameRecords(lenses, "test_lenses_json.bin");
+
+    // the hexagonal array written out lens by lens is the same array
+    auto n = SmallNearField();
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    std::vector<LensRecord> array;
+    for (auto const& c : n.oa_center)
+    {
+        array.push_back({ { c.X(), c.Y(), c.Z() }, { 0, 0, 1 }, n.Dlens, 0 });
+    }
+
+    WriteLensGeometry("test_lenses.bin", array);
+    auto loaded = SmallNearField();
+    loaded.lens_geometry_file = "test_lenses.bin";
+    passed = passed && SameIntensity(I, loaded.R00(*target), 0);
+
+    for (auto name : { "test_lenses.bin", "test_lenses_bad.bin", "test_lenses.csv", "test_lenses_params.json",
+        "test_lenses_csv.bin", "test_lenses.json", "test_lenses_json.bin" })
+    {
+        remove(name);
+    }
+
+    return passed;
+}
+
+bool TestApodizationThreshold()
+{
+    auto n = SmallNearField();
+    n.emitter_apodization = "gaussian";
+    auto target = n.MakeTarget();
+    auto I = n.R00(*target);
+
+    auto pruned = n;
+    pruned.apodization_threshold = 0.1;
+    auto Ipruned = pruned.R00(*target);
+
+    // the weight dropped from below a tenth of the peak, as a fraction of the
+    // total
+    auto peak = *std::max_element(n.lens_weight.begin(), n.lens_weight.end());
+    floatType total = 0;
+    floatType dropped = 0;
+    int kept = 0;
+    for (auto weight : n.lens_weight)
+    {
+        total += weight;
+        dropped += (weight < pruned.apodization_threshold * peak) ? weight : 0;
+        kept += (weight < pruned.apodization_threshold * peak) ? 0 : 1;
+    }
+
+    auto error = dropped / total;
+    bool passed = n.apodization_error == 0 && pruned.n_lens_pts == kept && kept < n.n_lens_pts &&
+        fabs(pruned.apodization_error - error) <= 1e-12 * error;
+
+    // each lens point adds at most its weight to |U|, so I moves by at most
+    // (2 e + e^2) of the coherent peak (n_lenses x total weight)^2
+    auto coherent = n.n_lenses * total;
+    auto bound = (2 * error + error * error) * coherent * coherent;
+    for (size_t q = 0; q < I.size(); ++q)
+    {
+        passed = passed && fabs(Ipruned.begin()[q] - I.begin()[q]) <= bound;
+    }
+
+    return passed;
+}
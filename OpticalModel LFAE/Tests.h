@@ -6,8 +6,34 @@ bool TestDotProduct();
 bool TestNorm(); // Should be in a test vector file
 bool TestRotate3d();
 
+bool TestArray2D();
 bool TestArraySetup();
 bool TestClosePackCenters();
+bool TestLensSampling();
+bool TestTargetGeometry();
+bool TestTargetMetric();
+bool TestZernike();
+bool TestApodization();
+bool TestPhilox();
+bool TestSpaceFillingCurve();
 bool TestPointPlaneNormalDistance();
+bool TestVolumeSlice();
+bool TestPartialFieldCache();
+bool TestMetricGradient();
+bool TestPhaseScreen();
+bool TestWeakTurbulence();
+bool TestMonteCarloThreads();
+bool TestZeroNoiseTiltedArray();
+bool TestFovCulling();
+bool TestTargetSource();
+bool TestRegions();
+bool TestTileCache();
+bool TestEvaluatePhases();
+bool TestSpgd();
+bool TestPhaseRetrieval();
+bool TestFailureScan();
+bool TestTransientPhaseNoise();
+bool TestLensGeometry();
+bool TestApodizationThreshold();
 
 bool RunTests();
@@ -92,19 +92,14 @@ namespace VectorMath
         return (DotProduct(P, N) - DotProduct(N, Q)) / dotNV;
     }
 
+    // Rotation by r_theta (right handed) about the unit vector r_axis
     template<typename T>
-    Vector3<T> RotatePoint3d(Point3<T> const& r_center, T r_theta, Vector3<T> r_axis, Point3<T> const& point)
+    Matrix3x3<T> RotationMatrix(T r_theta, Vector3<T> const& r_axis)
     {
-        if (ApproximatelyZero(r_theta) || ApproximatelyZero(r_axis.Norm()))
-        {
-            return point;
-        }
-
-        r_axis.Normalize();
         auto cosTheta = cos(r_theta);
         auto oneMinusCosTheta = 1 - cosTheta;
         auto sinTheta = sin(r_theta);
-        Matrix3x3<T> rotationMatrix(
+        return Matrix3x3<T>(
             static_cast<T>(cosTheta + r_axis.X() * r_axis.X() * oneMinusCosTheta),
             static_cast<T>(-r_axis.Z() * sinTheta + r_axis.X() * r_axis.Y() * oneMinusCosTheta),
             static_cast<T>(r_axis.Y() * sinTheta + r_axis.X() * r_axis.Z() * oneMinusCosTheta),
@@ -117,9 +112,59 @@ namespace VectorMath
             static_cast<T>(r_axis.X() * sinTheta + r_axis.Y() * r_axis.Z() * oneMinusCosTheta),
             static_cast<T>(cosTheta + r_axis.Z() * r_axis.Z() * oneMinusCosTheta)
         );
+    }
+
+    template<typename T>
+    Vector3<T> RotatePoint3d(Point3<T> const& r_center, T r_theta, Vector3<T> r_axis, Point3<T> const& point)
+    {
+        if (ApproximatelyZero(r_theta) || ApproximatelyZero(r_axis.Norm()))
+        {
+            return point;
+        }
 
-        auto result = rotationMatrix * point;
+        r_axis.Normalize();
+        auto result = RotationMatrix(r_theta, r_axis) * point;
 
         return result + r_center;
     }
+
+    // The unit vector axis turned by atan(tanX) toward its own x direction
+    // and atan(tanY) toward its y direction, the frame of the axis taken
+    // from (1, 0, 0), or (0, 1, 0) for an axis near x.  Not normalized;
+    // for axis (0, 0, 1) it is exactly (tanX, tanY, 1).
+    template<typename T>
+    Vector3<T> TiltAxis(Vector3<T> const& axis, T tanX, T tanY)
+    {
+        auto reference = (fabs(axis.X()) < 0.9) ? Vector3<T>(1, 0, 0) : Vector3<T>(0, 1, 0);
+        auto v = CrossProduct(axis, reference);
+        v.Normalize();
+        auto u = CrossProduct(v, axis);
+
+        return Vector3<T>(
+            axis.X() + tanX * u.X() + tanY * v.X(),
+            axis.Y() + tanX * u.Y() + tanY * v.Y(),
+            axis.Z() + tanX * u.Z() + tanY * v.Z());
+    }
+
+    // out[i] = rotation * in[i] + translation for count points; the matrix
+    // is built once by the caller and its elements are held in locals, so
+    // the loop is a straight multiply-add pass the compiler can vectorize
+    template<typename T>
+    void RotateTranslatePoints(Matrix3x3<T> const& rotation, Vector3<T> const& translation,
+        Point3<T> const* in, Point3<T>* out, size_t count)
+    {
+        auto a = rotation.A(), b = rotation.B(), c = rotation.C();
+        auto p = rotation.P(), q = rotation.Q(), r = rotation.R();
+        auto u = rotation.U(), v = rotation.V(), w = rotation.W();
+        auto tx = translation.X(), ty = translation.Y(), tz = translation.Z();
+
+        for (size_t i = 0; i < count; ++i)
+        {
+            auto x = in[i].X(), y = in[i].Y(), z = in[i].Z();
+            out[i] = Point3<T>(
+                a * x + b * y + c * z + tx,
+                p * x + q * y + r * z + ty,
+                u * x + v * y + w * z + tz);
+        }
+    }
 }
\ No newline at end of file
@@ -8,15 +8,8 @@
 
 static const std::string separator(", ");
 
-void WriteToCSV(std::string const& filename, Array2D<floatType>& data)
+static void WriteRows(FILE* file, Array2D<floatType>& data)
 {
-    FILE* file;
-    fopen_s(&file, filename.c_str(), "wt");
-    if (!file)
-    {
-        throw "File not opened";
-    }
-
     for (int row = 0; row < data.rows(); ++row)
     {
         std::string line;
@@ -32,6 +25,41 @@ void WriteToCSV(std::string const& filename, Array2D<floatType>& data)
 
         fprintf(file, line.c_str());
     }
+}
+
+void WriteToCSV(std::string const& filename, Array2D<floatType>& data)
+{
+    FILE* file;
+    fopen_s(&file, filename.c_str(), "wt");
+    if (!file)
+    {
+        throw "File not opened";
+    }
+
+    WriteRows(file, data);
+
+    fclose(file);
+}
+
+// Arrays one after another, separated by a blank line
+void WriteToCSV(std::string const& filename, std::vector<Array2D<floatType>>& arrays)
+{
+    FILE* file;
+    fopen_s(&file, filename.c_str(), "wt");
+    if (!file)
+    {
+        throw "File not opened";
+    }
+
+    for (size_t array = 0; array < arrays.size(); ++array)
+    {
+        if (array > 0)
+        {
+            fprintf(file, "\n");
+        }
+
+        WriteRows(file, arrays[array]);
+    }
 
     fclose(file);
 }
@@ -70,3 +98,27 @@ void WriteToCSV(std::string const& filename, std::vector<floatType> const& data)
     fclose(file);
 }
 
+// One line per target point - x, y, z, I
+void WriteToCSV(std::string const& filename, TargetGeometry<floatType> const& target, Array2D<floatType>& data)
+{
+    assert(target.rows() == data.rows() && target.cols() == data.cols());
+
+    FILE* file;
+    fopen_s(&file, filename.c_str(), "wt");
+    if (!file)
+    {
+        throw "File not opened";
+    }
+
+    for (int row = 0; row < data.rows(); ++row)
+    {
+        for (int col = 0; col < data.cols(); ++col)
+        {
+            auto point = target.Point(row, col);
+            fprintf(file, "%f%s%f%s%f%s%f\n", point.X(), separator.c_str(), point.Y(), separator.c_str(), point.Z(), separator.c_str(), data[row][col]);
+        }
+    }
+
+    fclose(file);
+}
+
@@ -4,8 +4,11 @@
 
 #include "Array2D.h"
 #include "DataType.h"
+#include "TargetGeometry.h"
 #include "VectorMath.h"
 
 void WriteToCSV(std::string const& filename, Array2D<floatType>& data);
 void WriteToCSV(std::string const& filename, std::vector<Point3<floatType>> const& data);
-void WriteToCSV(std::string const& filename, std::vector<floatType> const& data);
\ No newline at end of file
+void WriteToCSV(std::string const& filename, std::vector<floatType> const& data);
+void WriteToCSV(std::string const& filename, TargetGeometry<floatType> const& target, Array2D<floatType>& data);
+void WriteToCSV(std::string const& filename, std::vector<Array2D<floatType>>& arrays);
\ No newline at end of file
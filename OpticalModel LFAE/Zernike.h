@@ -0,0 +1,89 @@
+#pragma once
+
+#define _USE_MATH_DEFINES
+
+#include <assert.h>
+#include <math.h>
+#include <stdlib.h>
+#include <vector>
+#include "Array2D.h"
+#include "Vector3.h"
+
+// Zernike polynomials on the unit disk, in Noll's single index order and
+// normalization (unit rms over the disk):
+//   1 piston, 2 tip, 3 tilt, 4 defocus, 5 - 6 astigmatism, 7 - 8 coma,
+//   9 - 10 trefoil, 11 spherical, ...
+// Even j are the cos(m theta) terms and odd j the sin(m theta) terms.
+
+inline void NollToRadialAzimuthal(int j, int& n, int& m)
+{
+    assert(j >= 1);
+
+    n = 0;
+    while (j > (n + 1) * (n + 2) / 2)
+    {
+        ++n;
+    }
+
+    // position within the row of order n, |m| ascending in pairs
+    int k = j - n * (n + 1) / 2 - 1;
+    m = (n % 2 == 0) ? 2 * ((k + 1) / 2) : 2 * (k / 2) + 1;
+}
+
+template<typename T>
+T ZernikeRadial(int n, int m, T rho)
+{
+    T R = 0;
+    for (int s = 0; s <= (n - m) / 2; ++s)
+    {
+        // (n - s)! / (s! ((n + m) / 2 - s)! ((n - m) / 2 - s)!)
+        double c = 1;
+        for (int f = 2; f <= n - s; ++f) c *= f;
+        for (int f = 2; f <= s; ++f) c /= f;
+        for (int f = 2; f <= (n + m) / 2 - s; ++f) c /= f;
+        for (int f = 2; f <= (n - m) / 2 - s; ++f) c /= f;
+
+        R += static_cast<T>(((s % 2) ? -c : c) * pow(rho, n - 2 * s));
+    }
+
+    return R;
+}
+
+template<typename T>
+T Zernike(int j, T rho, T theta)
+{
+    int n, m;
+    NollToRadialAzimuthal(j, n, m);
+
+    auto R = ZernikeRadial(n, m, rho);
+    if (m == 0)
+    {
+        return static_cast<T>(sqrt(n + 1) * R);
+    }
+
+    auto angular = (j % 2 == 0) ? cos(m * theta) : sin(m * theta);
+    return static_cast<T>(sqrt(2 * (n + 1)) * R * angular);
+}
+
+// Table of the first nterms polynomials at each lens template point;
+// row i_pt, column j - 1.  The points are in the x - y plane, and radius is
+// the lens aperture radius.
+template<typename T>
+Array2D<T> ZernikeBasis(std::vector<Point3<T>> const& points, T radius, int nterms)
+{
+    assert(radius > 0);
+    assert(nterms > 0);
+
+    Array2D<T> basis(static_cast<int>(points.size()), nterms);
+    for (int i_pt = 0; i_pt < basis.rows(); ++i_pt)
+    {
+        auto rho = static_cast<T>(sqrt(points[i_pt].X() * points[i_pt].X() + points[i_pt].Y() * points[i_pt].Y()) / radius);
+        auto theta = static_cast<T>(atan2(points[i_pt].Y(), points[i_pt].X()));
+        for (int j = 1; j <= nterms; ++j)
+        {
+            basis[i_pt][j - 1] = Zernike(j, rho, theta);
+        }
+    }
+
+    return basis;
+}